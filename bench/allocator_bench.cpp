@@ -0,0 +1,276 @@
+// Allocator microbenchmarks: per-frame scratch churn, spawn/despawn bursts and
+// multithreaded allocation, comparing our allocators against the system malloc.
+// Build with `sh build.sh bench` and run build/allocator_bench.
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "utils/bump_allocator.hpp"
+#include "utils/frame_allocator.hpp"
+#include "utils/pool_allocator.hpp"
+#include "utils/tlsf_allocator.hpp"
+
+namespace {
+  const size_t frame_count         = 1000;
+  const size_t frame_allocs        = 4096;
+  const size_t burst_rounds        = 200;
+  const size_t burst_size          = 8192;
+  const size_t total_thread_allocs = 1 << 22;
+  const size_t megabyte            = 1024 * 1024;
+  const size_t scratch_capacity    = 8 * megabyte;
+
+  /**
+   * Stand-in for a particle or entity, exactly one cache line.
+   */
+  struct Particle {
+    float position[2];
+    float velocity[2];
+    float color[4];
+    float life;
+    int sprite;
+    char padding[24];
+  };
+
+  /**
+   * Pre-generated random sizes so the timed loops measure only the allocators.
+   */
+  std::vector<size_t> make_sizes(size_t count, size_t min, size_t max, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<size_t> distribution(min, max);
+
+    std::vector<size_t> sizes(count);
+    for(size_t& size : sizes) { size = distribution(rng); }
+
+    return sizes;
+  }
+
+  // Set when an allocation of the running case failed, the case stops and its row reports it.
+  std::atomic<bool> case_failed{false};
+
+  /**
+   * Touch an allocation of the running case, or flag the case as failed.
+   *
+   * @param memory The allocation, nullptr if it failed.
+   * @return Whether or not the allocation succeeded.
+   */
+  bool touch_allocation(void* memory) {
+    if(!memory) {
+      case_failed.store(true, std::memory_order_relaxed);
+      return false;
+    }
+
+    bench::touch(memory);
+    return true;
+  }
+
+  /**
+   * Print the row of a case, or that it was aborted.
+   *
+   * @param result The result of the case.
+   */
+  void report(const bench::Result& result) {
+    if(case_failed.exchange(false)) {
+      printf("%-40s aborted, an allocation failed\n", result.name);
+      return;
+    }
+
+    bench::print_result(result);
+  }
+
+  // Per-frame scratch churn
+  void bench_scratch_churn() {
+    bench::print_header("Per-frame scratch churn (4096 allocations of 16-512 bytes per frame)");
+
+    std::vector<size_t> sizes = make_sizes(frame_allocs, 16, 512, 1);
+    std::vector<void*> pointers(frame_allocs);
+    size_t operations = frame_count * frame_allocs;
+
+    report(bench::run("malloc + free", operations, [&] {
+      for(size_t frame = 0; frame < frame_count; frame++) {
+        for(size_t i = 0; i < frame_allocs; i++) {
+          pointers[i] = malloc(sizes[i]);
+          bench::touch(pointers[i]);
+        }
+        for(size_t i = 0; i < frame_allocs; i++) { free(pointers[i]); }
+      }
+    }));
+
+    report(bench::run("bump_allocator::allocate + reset", operations, [&] {
+      bump_allocator::BumpAllocator allocator = bump_allocator::create_allocator(scratch_capacity);
+      for(size_t frame = 0; frame < frame_count && !case_failed; frame++) {
+        for(size_t i = 0; i < frame_allocs; i++) {
+          if(!touch_allocation(bump_allocator::allocate(&allocator, sizes[i]))) { break; }
+        }
+        bump_allocator::reset(&allocator);
+      }
+      bump_allocator::destroy_allocator(&allocator);
+    }));
+
+    report(bench::run("bump_allocator virtual + reset", operations, [&] {
+      bump_allocator::BumpAllocator allocator = bump_allocator::create_virtual_allocator(1024 * megabyte);
+      for(size_t frame = 0; frame < frame_count && !case_failed; frame++) {
+        for(size_t i = 0; i < frame_allocs; i++) {
+          if(!touch_allocation(bump_allocator::allocate(&allocator, sizes[i]))) { break; }
+        }
+        bump_allocator::reset(&allocator);
+      }
+      bump_allocator::destroy_allocator(&allocator);
+    }));
+
+    report(bench::run("frame_allocator double-buffered", operations, [&] {
+      frame_allocator::FrameAllocator frames = frame_allocator::create_frame_allocator(64 * megabyte);
+      for(size_t frame = 0; frame < frame_count && !case_failed; frame++) {
+        bump_allocator::BumpAllocator* allocator = frame_allocator::current(&frames);
+        for(size_t i = 0; i < frame_allocs; i++) {
+          if(!touch_allocation(bump_allocator::allocate(allocator, sizes[i]))) { break; }
+        }
+        frame_allocator::swap(&frames);
+      }
+      frame_allocator::destroy_frame_allocator(&frames);
+    }));
+
+    report(bench::run("tlsf_allocator allocate + deallocate", operations, [&] {
+      bump_allocator::BumpAllocator backing = bump_allocator::create_allocator(scratch_capacity);
+      tlsf_allocator::TlsfAllocator heap    = tlsf_allocator::create_allocator(&backing, scratch_capacity);
+      for(size_t frame = 0; frame < frame_count && !case_failed; frame++) {
+        size_t count = 0;
+        for(; count < frame_allocs; count++) {
+          pointers[count] = tlsf_allocator::allocate(&heap, sizes[count]);
+          if(!touch_allocation(pointers[count])) { break; }
+        }
+        for(size_t i = 0; i < count; i++) { tlsf_allocator::deallocate(&heap, pointers[i]); }
+      }
+      bump_allocator::destroy_allocator(&backing);
+    }));
+  }
+
+  // Spawn/despawn bursts
+  void bench_spawn_despawn() {
+    bench::print_header("Spawn/despawn bursts (8192 particles spawned, random half despawned per round)");
+
+    // Every round spawns a burst, then despawns a random half of everything alive.
+    std::mt19937 rng(2);
+    std::vector<Particle*> alive;
+    alive.reserve(burst_rounds * burst_size);
+    size_t operations = burst_rounds * burst_size;
+
+    auto simulate = [&](auto spawn, auto despawn) {
+      alive.clear();
+      rng.seed(2);
+
+      for(size_t round = 0; round < burst_rounds; round++) {
+        for(size_t i = 0; i < burst_size; i++) { alive.push_back(spawn()); }
+
+        std::shuffle(alive.begin(), alive.end(), rng);
+        size_t keep = alive.size() / 2;
+        for(size_t i = keep; i < alive.size(); i++) { despawn(alive[i]); }
+        alive.resize(keep);
+      }
+
+      for(Particle* particle : alive) { despawn(particle); }
+    };
+
+    report(bench::run("malloc + free", operations, [&] {
+      simulate([] { return (Particle*)malloc(sizeof(Particle)); }, [](Particle* particle) { free(particle); });
+    }));
+
+    report(bench::run("pool_allocator create + destroy", operations, [&] {
+      size_t capacity                       = 2 * burst_size * sizeof(Particle) + bump_allocator::cache_line_size;
+      bump_allocator::BumpAllocator backing = bump_allocator::create_allocator(capacity);
+      pool_allocator::PoolAllocator pool    = pool_allocator::create_pool<Particle>(&backing, 2 * burst_size);
+      simulate([&] { return pool_allocator::create<Particle>(&pool); },
+               [&](Particle* particle) { pool_allocator::destroy(&pool, particle); });
+      bump_allocator::destroy_allocator(&backing);
+    }));
+
+    report(bench::run("tlsf_allocator allocate + deallocate", operations, [&] {
+      bump_allocator::BumpAllocator backing = bump_allocator::create_allocator(4 * megabyte);
+      tlsf_allocator::TlsfAllocator heap    = tlsf_allocator::create_allocator(&backing, 4 * megabyte);
+      simulate([&] { return tlsf_allocator::allocate<Particle>(&heap); },
+               [&](Particle* particle) { tlsf_allocator::deallocate(&heap, particle); });
+      bump_allocator::destroy_allocator(&backing);
+    }));
+  }
+
+  // Multithreaded allocation
+  template <typename F>
+  void run_threads(size_t thread_count, F body) {
+    std::vector<std::thread> threads;
+    for(size_t i = 0; i < thread_count; i++) { threads.emplace_back(body, i); }
+    for(std::thread& thread : threads) { thread.join(); }
+  }
+
+  void bench_multithreaded() {
+    // The same total work split across the threads, so the memory used doesn't grow with the core count.
+    size_t thread_count  = std::max(4u, std::thread::hardware_concurrency());
+    size_t thread_allocs = total_thread_allocs / thread_count;
+
+    char title[128];
+    snprintf(title, sizeof(title), "Multithreaded allocation (%zu threads, 32-256 bytes)", thread_count);
+    bench::print_header(title);
+
+    std::vector<size_t> sizes = make_sizes(thread_allocs, 32, 256, 3);
+    size_t operations         = thread_count * thread_allocs;
+
+    // Every size rounded up to the default alignment, which bounds the padding. Sub allocators are rounded up to a
+    // cache line and aligned to one in their parent, two more cache lines each at worst.
+    size_t alignment       = bump_allocator::default_alignment;
+    size_t thread_capacity = std::accumulate(sizes.begin(), sizes.end(), (size_t)0) + thread_allocs * alignment;
+    size_t shared_capacity = thread_count * (thread_capacity + 2 * bump_allocator::cache_line_size);
+
+    report(bench::run("malloc + free", operations, [&] {
+      run_threads(thread_count, [&](size_t) {
+        std::vector<void*> pointers(thread_allocs);
+        for(size_t i = 0; i < thread_allocs; i++) {
+          pointers[i] = malloc(sizes[i]);
+          bench::touch(pointers[i]);
+        }
+        for(void* pointer : pointers) { free(pointer); }
+      });
+    }));
+
+    report(bench::run("ConcurrentBumpAllocator fetch-add", operations, [&] {
+      bump_allocator::ConcurrentBumpAllocator allocator = bump_allocator::create_concurrent_allocator(shared_capacity);
+      run_threads(thread_count, [&](size_t) {
+        for(size_t i = 0; i < thread_allocs; i++) {
+          if(!touch_allocation(bump_allocator::allocate(&allocator, sizes[i]))) { return; }
+        }
+      });
+      bump_allocator::destroy_allocator(&allocator);
+    }));
+
+    report(bench::run("per-thread sub allocators", operations, [&] {
+      bump_allocator::ConcurrentBumpAllocator parent = bump_allocator::create_concurrent_allocator(shared_capacity);
+      run_threads(thread_count, [&](size_t) {
+        bump_allocator::BumpAllocator allocator = bump_allocator::create_sub_allocator(&parent, thread_capacity);
+        for(size_t i = 0; i < thread_allocs; i++) {
+          if(!touch_allocation(bump_allocator::allocate(&allocator, sizes[i]))) { return; }
+        }
+      });
+      bump_allocator::destroy_allocator(&parent);
+    }));
+  }
+}  // namespace
+
+int main() {
+  // Instrumentation stays on like in development builds, build with -DSM_ALLOCATOR_STATS=0 to measure without it.
+  printf("allocator_bench, SM_ALLOCATOR_STATS=%d\n", SM_ALLOCATOR_STATS);
+
+  // The allocators trace every creation, which would land in the middle of the tables. Failures still show.
+  logger::set_level(logger::category::allocator, logger::level::warn);
+
+  bench_scratch_churn();
+  bench_spawn_despawn();
+  bench_multithreaded();
+
+  logger::set_level(logger::category::allocator, logger::level::trace);
+
+  return 0;
+}
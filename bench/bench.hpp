@@ -0,0 +1,106 @@
+#pragma once
+#ifndef _BENCH_HPP
+#define _BENCH_HPP
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+namespace bench {
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * Result of a single benchmark case.
+   */
+  struct Result {
+    const char* name;   // name of the case
+    size_t operations;  // amount of operations timed
+    double elapsed_ns;  // wall time of the whole case
+    long peak_rss_kb;   // peak resident set size while the case ran, -1 if unknown
+  };
+
+  /**
+   * Write to freshly allocated memory, like real code would, so untouched
+   * pages don't flatter an allocator's RSS and the allocation can't be elided.
+   *
+   * @param memory The memory to write to.
+   */
+  inline void touch(void* memory) { *(volatile char*)memory = 0; }
+
+  /**
+   * Reset the peak RSS of the process (VmHWM), Linux only.
+   */
+  inline void reset_peak_rss() {
+    if(FILE* file = fopen("/proc/self/clear_refs", "w")) {
+      fputs("5", file);
+      fclose(file);
+    }
+  }
+
+  /**
+   * Get the peak RSS of the process since the last reset_peak_rss.
+   *
+   * @return The peak RSS in KiB, -1 if it can't be read.
+   */
+  inline long get_peak_rss_kb() {
+    FILE* file = fopen("/proc/self/status", "r");
+    if(!file) { return -1; }
+
+    long peak = -1;
+    char line[256];
+    while(fgets(line, sizeof(line), file)) {
+      if(strncmp(line, "VmHWM:", 6) == 0) {
+        peak = atol(line + 6);
+        break;
+      }
+    }
+
+    fclose(file);
+    return peak;
+  }
+
+  /**
+   * Time a benchmark case.
+   *
+   * @param name The name of the case.
+   * @param operations The amount of operations body performs.
+   * @param body The code to time.
+   * @return The result of the case.
+   */
+  template <typename F>
+  Result run(const char* name, size_t operations, F&& body) {
+    reset_peak_rss();
+
+    clock::time_point start = clock::now();
+    body();
+    clock::time_point end = clock::now();
+
+    return {name, operations, std::chrono::duration<double, std::nano>(end - start).count(), get_peak_rss_kb()};
+  }
+
+  /**
+   * Print the header of the result table.
+   *
+   * @param title The title of the group of cases.
+   */
+  inline void print_header(const char* title) {
+    printf("\n%s\n", title);
+    printf("%-40s %12s %12s %14s %12s\n", "case", "ops", "ns/op", "Mops/s", "peak RSS MB");
+  }
+
+  /**
+   * Print a row of the result table.
+   *
+   * @param result The result to print.
+   */
+  inline void print_result(const Result& result) {
+    double ns_per_op = result.elapsed_ns / (double)result.operations;
+
+    printf("%-40s %12zu %12.2f %14.2f %12.1f\n", result.name, result.operations, ns_per_op, 1000.0 / ns_per_op,
+           result.peak_rss_kb / 1024.0);
+  }
+}  // namespace bench
+
+#endif  // _BENCH_HPP
@@ -0,0 +1,200 @@
+// Logger benchmarks: caller-side latency percentiles and total throughput for
+// each sink and formatting mode, with one and several producer threads.
+// Build with `sh build.sh bench` and run build/logger_bench.
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "bench.hpp"
+#include "utils/logger.hpp"
+
+namespace {
+  const size_t records_per_thread = 100000;
+  const size_t ring_capacity      = 4096;
+
+  const char* const file_path   = "/tmp/logger_bench.log";
+  const char* const index_path  = "/tmp/logger_bench.log.idx";
+  const char* const binary_path = "/tmp/logger_bench.smlog";
+
+  /**
+   * Where the records go and how they are formatted.
+   */
+  enum class mode
+  {
+    filtered,       // category disabled at runtime, nothing is formatted
+    null_sync,      // formatted on the caller, written nowhere
+    null_async,     // formatted on the caller, queued, written nowhere
+    console_sync,   // formatted and written to stdout on the caller
+    console_async,  // formatted on the caller, written to stdout by the background thread
+    file_sync,      // formatted and appended to the mapped file on the caller
+    file_async,     // formatted on the caller, appended to the mapped file by the background thread
+    binary_sync,    // arguments encoded and written to the binary file on the caller
+    binary_async    // arguments encoded on the caller, written to the binary file by the background thread
+  };
+
+  /**
+   * A benchmark case.
+   */
+  struct Case {
+    const char* name;  // name of the case
+    mode sink;         // the sink and formatting mode
+  };
+
+  const Case cases[] = {
+      {"filtered out (runtime category)", mode::filtered},
+      {"null sink, sync text", mode::null_sync},
+      {"null sink, async text", mode::null_async},
+      {"console (/dev/null), sync text", mode::console_sync},
+      {"console (/dev/null), async text", mode::console_async},
+      {"mapped file, sync text", mode::file_sync},
+      {"mapped file, async text", mode::file_async},
+      {"binary file, sync", mode::binary_sync},
+      {"binary file, async", mode::binary_async},
+  };
+
+  /**
+   * Get the cost of reading the clock around each call, subtracted from the
+   * latencies.
+   *
+   * @return The median cost in nanoseconds.
+   */
+  double measure_clock_overhead() {
+    std::vector<double> samples(10000);
+    for(double& sample : samples) {
+      bench::clock::time_point start = bench::clock::now();
+      bench::clock::time_point end   = bench::clock::now();
+      sample                         = std::chrono::duration<double, std::nano>(end - start).count();
+    }
+
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+  }
+
+  /**
+   * Set the logger up for a case.
+   *
+   * @param sink The sink and formatting mode of the case.
+   */
+  void begin_case(mode sink) {
+    bool async = sink == mode::null_async || sink == mode::console_async || sink == mode::file_async ||
+                 sink == mode::binary_async;
+    if(async) { logger::start_async(ring_capacity, logger::overflow_policy::block); }
+
+    logger::console_active = sink == mode::console_sync || sink == mode::console_async;
+    logger::history_active = sink != mode::null_sync && sink != mode::null_async;
+    if(sink == mode::file_sync || sink == mode::file_async) { logger::start_file(file_path, 64 * 1024 * 1024, 1); }
+    if(sink == mode::binary_sync || sink == mode::binary_async) { logger::start_binary(binary_path); }
+    if(sink == mode::filtered) { logger::set_level(logger::category::game, logger::level::count); }
+  }
+
+  /**
+   * Write everything out and restore the logger.
+   */
+  void end_case() {
+    logger::flush();
+    logger::stop_file();
+    logger::stop_binary();
+    logger::stop_async();
+
+    logger::set_level(logger::category::game, logger::level::trace);
+    logger::console_active = true;
+    logger::history_active = true;
+
+    remove(file_path);
+    remove(index_path);
+    remove(binary_path);
+  }
+
+  /**
+   * Run a case and print its row.
+   *
+   * @param test The case to run.
+   * @param thread_count The amount of producer threads.
+   * @param clock_overhead The cost of reading the clock, in nanoseconds.
+   */
+  void run_case(const Case& test, size_t thread_count, double clock_overhead) {
+    std::vector<std::vector<float>> latencies(thread_count, std::vector<float>(records_per_thread));
+
+    // The console sink writes to /dev/null, the results still go to the real stdout.
+    fflush(stdout);
+    int saved_stdout = dup(STDOUT_FILENO);
+    int null_output  = open("/dev/null", O_WRONLY);
+    dup2(null_output, STDOUT_FILENO);
+    close(null_output);
+
+    begin_case(test.sink);
+
+    bench::clock::time_point start = bench::clock::now();
+
+    std::vector<std::thread> threads;
+    for(size_t t = 0; t < thread_count; t++) {
+      threads.emplace_back([&, t] {
+        std::vector<float>& samples = latencies[t];
+
+        for(size_t i = 0; i < records_per_thread; i++) {
+          bench::clock::time_point before = bench::clock::now();
+          SM_CTRACE(game, "Player {} moved to ({}, {}) in state {}", t, 1.5f * i, -2.25f, "dashing");
+          bench::clock::time_point after = bench::clock::now();
+
+          samples[i] = (float)std::chrono::duration<double, std::nano>(after - before).count();
+        }
+      });
+    }
+    for(std::thread& thread : threads) { thread.join(); }
+
+    end_case();
+
+    // Throughput counts until every record was written, not only queued.
+    double elapsed_ns = std::chrono::duration<double, std::nano>(bench::clock::now() - start).count();
+
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    close(saved_stdout);
+
+    std::vector<float> all;
+    all.reserve(thread_count * records_per_thread);
+    for(const std::vector<float>& samples : latencies) { all.insert(all.end(), samples.begin(), samples.end()); }
+    std::sort(all.begin(), all.end());
+
+    auto percentile = [&](double fraction) {
+      double value = all[(size_t)(fraction * (all.size() - 1))] - clock_overhead;
+      return value < 0.0 ? 0.0 : value;
+    };
+
+    size_t records = thread_count * records_per_thread;
+    printf("%-36s %8zu %10.1f %10.1f %12.1f %12.2f\n", test.name, thread_count, percentile(0.5), percentile(0.99),
+           percentile(1.0), records / elapsed_ns * 1000.0);
+  }
+
+  /**
+   * Print the header of the result table.
+   *
+   * @param title The title of the group of cases.
+   */
+  void print_header(const char* title) {
+    printf("\n%s\n", title);
+    printf("%-36s %8s %10s %10s %12s %12s\n", "case", "threads", "p50 ns", "p99 ns", "max ns", "Mrec/s");
+  }
+}  // namespace
+
+int main() {
+  double clock_overhead = measure_clock_overhead();
+  size_t thread_count   = std::max(4u, std::thread::hardware_concurrency());
+
+  printf("logger_bench, %zu records per thread, clock overhead %.1f ns subtracted from latencies\n", records_per_thread,
+         clock_overhead);
+
+  print_header("Single producer");
+  for(const Case& test : cases) { run_case(test, 1, clock_overhead); }
+
+  char title[64];
+  snprintf(title, sizeof(title), "%zu producers", thread_count);
+  print_header(title);
+  for(const Case& test : cases) { run_case(test, thread_count, clock_overhead); }
+
+  return 0;
+}
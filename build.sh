@@ -1,14 +1,57 @@
 #!/bin/bash
-EXENAME="celeste.exe"
+# Usage: sh build.sh [game|headless|bench|tools]
+#
+#   game      Win32/WGL executable (default).
+#   headless  Linux executable that drives the game loop without a window or GL context.
+#   bench     Linux benchmark executables, one per file in bench/.
+#   tools     Development tools, one executable per file in tools/.
+TARGET="${1:-game}"
 
-LIBS="-luser32 -lopengl32 -lgdi32 -Lsrc/lib"
-WARNINGS="-Wno-writable-strings -Wmacro-redefined -Wdeprecated-declarations"
 EXTENSIONS="-std=c++17"
 
-if [ -d "build" ]; then
-    rm -rf build
-fi
+mkdir -p build
 
-mkdir build
+case "$TARGET" in
+  game)
+    EXENAME="celeste.exe"
 
-clang++ -D_CRT_SECURE_NO_WARNINGS -Isrc/include $LIBS $WARNINGS $EXTENSIONS -g $(find src -name "*.cpp") -o build/$EXENAME
\ No newline at end of file
+    LIBS="-luser32 -lopengl32 -lgdi32 -Lsrc/lib"
+    WARNINGS="-Wno-writable-strings -Wmacro-redefined -Wdeprecated-declarations"
+
+    clang++ -D_CRT_SECURE_NO_WARNINGS -Isrc/include $LIBS $WARNINGS $EXTENSIONS -g $(find src -name "*.cpp") -o build/$EXENAME
+    ;;
+
+  headless)
+    EXENAME="celeste_headless"
+    CXX="${CXX:-clang++}"
+
+    LIBS="-lpthread"
+
+    $CXX -DSM_HEADLESS -Isrc/include $EXTENSIONS -O2 -g $(find src -name "*.cpp") $LIBS -o build/$EXENAME
+    ;;
+
+  bench)
+    CXX="${CXX:-clang++}"
+
+    LIBS="-lpthread"
+
+    for BENCH in bench/*.cpp; do
+      EXENAME="$(basename "$BENCH" .cpp)"
+      $CXX -DSM_HEADLESS -Isrc -Ibench $EXTENSIONS -O2 -g "$BENCH" $(find src/utils -name "*.cpp") $LIBS -o build/$EXENAME || exit 1
+    done
+    ;;
+
+  tools)
+    CXX="${CXX:-clang++}"
+
+    for TOOL in tools/*.cpp; do
+      EXENAME="$(basename "$TOOL" .cpp)"
+      $CXX -Isrc $EXTENSIONS -O2 -g "$TOOL" -o build/$EXENAME || exit 1
+    done
+    ;;
+
+  *)
+    echo "Unknown target: $TARGET"
+    exit 1
+    ;;
+esac
@@ -2,11 +2,19 @@
 #ifndef _GAME_HPP
 #define _GAME_HPP
 
+#include "utils/frame_allocator.hpp"
+
 namespace game {
   /**
    * Inline reference to check if the game is running.
    */
   inline bool running = true;
+
+  /**
+   * Per-frame scratch memory, double-buffered so the render data of the
+   * previous frame stays valid while the current one simulates.
+   */
+  inline frame_allocator::FrameAllocator frame_memory = {};
 }  // namespace game
 
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <iostream>
 #include <string>
@@ -8,15 +9,49 @@
 #include "window.hpp"
 
 // Folders in src/
+#include "utils/allocator_stats.hpp"
+#include "utils/async_io.hpp"
+#include "utils/debugging.hpp"
+#include "utils/file_watcher.hpp"
+#include "utils/frame_allocator.hpp"
 #include "utils/logger.hpp"
 
 int main() {
+  logger::start_async();
+  if(const char* log_path = getenv("SM_LOG_FILE")) { logger::start_file(log_path); }
+
+#ifndef NDEBUG
+  debugging::set_debug_mode(true);
+#endif
+  debugging::save_debug_info_on_crash();
+  async_io::start();
+  file_watcher::start();
+
   SM_TRACE("Starting Celeste...");
   SM_ASSERT(window::create_window(400, 400, "Celeste Window"), "Failed to create window!");
 
+  game::frame_memory = frame_allocator::create_frame_allocator(64 * 1024 * 1024);
+
   SM_TRACE("Starting game loop...");
-  while(game::running) { window::update_window(); }
+  while(game::running) {
+    window::update_window();
+
+    frame_allocator::swap(&game::frame_memory);
+    allocator_stats::end_frame();
+    async_io::end_frame();
+
+    file_watcher::Changes changes = file_watcher::end_frame();
+    for(size_t i = 0; i < changes.count; i++) { SM_CTRACE(io, "{} changed.", changes.paths[i]); }
+
+    logger::end_frame();
+  }
 
   SM_TRACE("Stopping Celeste...");
+  frame_allocator::destroy_frame_allocator(&game::frame_memory);
+
+  file_watcher::stop();
+  async_io::stop();
+  logger::stop_file();
+  logger::stop_async();
   return 0;
 }
\ No newline at end of file
@@ -1,3 +1,6 @@
+// The OpenGL loader depends on WGL, headless builds have no GL context.
+#ifndef SM_HEADLESS
+
 #include "gl_renderer.hpp"
 
 #include <string.h>
@@ -20,9 +23,7 @@ namespace gl_renderer {
     FreeLibrary(module);
 
     if(!func) {
-      char error_string[256];
-      sprintf(error_string, "Failed to load OpenGL function: %s", name);
-      SM_ERROR(error_string);
+      SM_CERROR(renderer, "Failed to load OpenGL function: {}", name);
 
       return nullptr;
     }
@@ -220,4 +221,6 @@ namespace gl_renderer {
     glDebugMessageCallback(callback, userParam);
   }
 #pragma endregion
-}  // namespace gl_renderer
\ No newline at end of file
+}  // namespace gl_renderer
+
+#endif  // SM_HEADLESS
@@ -0,0 +1,305 @@
+#pragma once
+#ifndef _ALLOCATOR_STATS_HPP
+#define _ALLOCATOR_STATS_HPP
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+
+#include "logger.hpp"
+
+// Allocator instrumentation is on unless the build passes -DSM_ALLOCATOR_STATS=0,
+// in which case every record_* call compiles to nothing.
+#ifndef SM_ALLOCATOR_STATS
+#define SM_ALLOCATOR_STATS 1
+#endif
+
+// Manual AddressSanitizer poisoning, used to catch reads of memory that was
+// released by a reset or a rollback.
+#if defined(__SANITIZE_ADDRESS__)
+#define SM_HAS_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define SM_HAS_ASAN 1
+#endif
+#endif
+
+#ifdef SM_HAS_ASAN
+#include <sanitizer/asan_interface.h>
+#define SM_POISON_MEMORY(address, size)   __asan_poison_memory_region((address), (size))
+#define SM_UNPOISON_MEMORY(address, size) __asan_unpoison_memory_region((address), (size))
+#else
+#define SM_POISON_MEMORY(address, size)   ((void)(address), (void)(size))
+#define SM_UNPOISON_MEMORY(address, size) ((void)(address), (void)(size))
+#endif
+
+namespace allocator_stats {
+  /**
+   * Maximum amount of different tags, tag 0 is used for untagged allocators.
+   */
+  inline constexpr int max_tags = 32;
+
+  /**
+   * Byte written over released memory when poisoning is enabled.
+   */
+  inline constexpr unsigned char poison_byte = 0xDD;
+
+  /**
+   * Accounting of every allocator sharing a tag (e.g. "level", "render").
+   * Allocators of a tag may live on different threads, so the counters are
+   * relaxed atomics.
+   */
+  struct TagStats {
+    const char* name                     = nullptr;  // the caller supplied tag
+    std::atomic<size_t> allocation_count = {0};      // allocations since startup
+    std::atomic<size_t> allocated_bytes  = {0};      // bytes allocated since startup
+    std::atomic<size_t> current_bytes    = {0};      // bytes currently in use
+    std::atomic<size_t> peak_bytes       = {0};      // highest current_bytes seen
+    std::atomic<size_t> budget_bytes     = {0};      // 0 if the tag has no budget
+    std::atomic<bool> over_budget        = {false};  // whether the budget warning was already logged
+  };
+
+  /**
+   * Counters of a single frame, updated from any thread.
+   */
+  struct FrameCounters {
+    std::atomic<size_t> allocation_count       = {0};  // allocations from bump allocators
+    std::atomic<size_t> allocated_bytes        = {0};  // bytes allocated from bump allocators
+    std::atomic<size_t> block_allocation_count = {0};  // blocks handed out by pool allocators
+    std::atomic<size_t> free_count             = {0};  // blocks given back to pool allocators
+    std::atomic<size_t> reset_count            = {0};  // bump allocator resets
+    std::atomic<size_t> rollback_count         = {0};  // bump allocator rollbacks to a marker
+  };
+
+  /**
+   * Counters of a finished frame.
+   */
+  struct FrameStats {
+    size_t allocation_count;        // allocations from bump allocators
+    size_t allocated_bytes;         // bytes allocated from bump allocators
+    size_t block_allocation_count;  // blocks handed out by pool allocators
+    size_t free_count;              // blocks given back to pool allocators
+    size_t reset_count;             // bump allocator resets
+    size_t rollback_count;          // bump allocator rollbacks to a marker
+  };
+
+  inline TagStats tags[max_tags]    = {{"untagged"}};
+  inline std::atomic<int> tag_count = {1};
+  inline std::mutex tag_mutex;
+
+  inline FrameCounters current_frame;
+  inline FrameStats last_frame = {};
+
+  /**
+   * Whether released memory is filled with poison_byte (and poisoned for
+   * AddressSanitizer builds) so use-after-reset bugs show up right away.
+   */
+  inline bool poison_on_reset = false;
+
+  /**
+   * Get the index of a tag, registering it the first time it is seen.
+   *
+   * @param name The name of the tag, must outlive the program (a string literal).
+   * @return The index of the tag, 0 if the tag table is full.
+   */
+  inline int register_tag(const char* name) {
+    if(!name) { return 0; }
+
+    std::lock_guard<std::mutex> lock(tag_mutex);
+
+    int count = tag_count.load(std::memory_order_relaxed);
+    for(int i = 0; i < count; i++) {
+      if(strcmp(tags[i].name, name) == 0) { return i; }
+    }
+
+    if(count == max_tags) {
+      SM_CWARN(allocator, "Allocator tag table is full, the new tag is accounted as untagged.");
+      return 0;
+    }
+
+    // Published by the store, dump reads the names without the lock.
+    tags[count].name = name;
+    tag_count.store(count + 1, std::memory_order_release);
+
+    return count;
+  }
+
+  /**
+   * Set the memory budget of a tag. A warning is logged the first time the
+   * bytes in use go over it.
+   *
+   * @param name The name of the tag.
+   * @param bytes The budget in bytes, 0 to remove it.
+   */
+  inline void set_budget(const char* name, size_t bytes) {
+    TagStats& stats = tags[register_tag(name)];
+    stats.budget_bytes.store(bytes, std::memory_order_relaxed);
+    stats.over_budget.store(false, std::memory_order_relaxed);
+  }
+
+  /**
+   * Record that `size` more bytes of a tag are in use, updating its peak and
+   * checking its budget.
+   *
+   * @param tag The index of the tag.
+   * @param size The amount of bytes.
+   */
+  inline void record_acquire(int tag, size_t size) {
+#if SM_ALLOCATOR_STATS
+    TagStats& stats = tags[tag];
+
+    size_t current = stats.current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak    = stats.peak_bytes.load(std::memory_order_relaxed);
+    while(current > peak && !stats.peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {}
+
+    size_t budget = stats.budget_bytes.load(std::memory_order_relaxed);
+    if(budget && current > budget && !stats.over_budget.exchange(true, std::memory_order_relaxed)) {
+      SM_CWARN(allocator, "Allocator tag '{}' is over its budget: {} of {} bytes in use.", stats.name, current, budget);
+    }
+#endif
+  }
+
+  /**
+   * Record an allocation of `size` bytes for a tag.
+   *
+   * @param tag The index of the tag.
+   * @param size The size of the allocation in bytes, including padding.
+   */
+  inline void record_allocation(int tag, size_t size) {
+#if SM_ALLOCATOR_STATS
+    TagStats& stats = tags[tag];
+    stats.allocation_count.fetch_add(1, std::memory_order_relaxed);
+    stats.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    record_acquire(tag, size);
+
+    current_frame.allocation_count.fetch_add(1, std::memory_order_relaxed);
+    current_frame.allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * Record that `size` bytes of a tag were released.
+   *
+   * @param tag The index of the tag.
+   * @param size The amount of bytes released.
+   */
+  inline void record_release(int tag, size_t size) {
+#if SM_ALLOCATOR_STATS
+    TagStats& stats = tags[tag];
+
+    // Never below zero, even if releases and allocations were recorded out of order.
+    size_t current = stats.current_bytes.load(std::memory_order_relaxed);
+    size_t left;
+    do {
+      left = size < current ? current - size : 0;
+    } while(!stats.current_bytes.compare_exchange_weak(current, left, std::memory_order_relaxed));
+
+    if(left <= stats.budget_bytes.load(std::memory_order_relaxed)) {
+      stats.over_budget.store(false, std::memory_order_relaxed);
+    }
+#endif
+  }
+
+  /**
+   * Record a bump allocator reset.
+   *
+   * @param tag The index of the tag.
+   * @param size The amount of bytes released by the reset.
+   */
+  inline void record_reset(int tag, size_t size) {
+#if SM_ALLOCATOR_STATS
+    record_release(tag, size);
+    current_frame.reset_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * Record a bump allocator rollback to a marker.
+   *
+   * @param tag The index of the tag.
+   * @param size The amount of bytes released by the rollback.
+   */
+  inline void record_rollback(int tag, size_t size) {
+#if SM_ALLOCATOR_STATS
+    record_release(tag, size);
+    current_frame.rollback_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * Record a block handed out by a pool allocator. Pool memory is already
+   * accounted to the tag of the bump allocator backing it, so blocks are only
+   * counted apart from the bump allocations.
+   */
+  inline void record_block_allocation() {
+#if SM_ALLOCATOR_STATS
+    current_frame.block_allocation_count.fetch_add(1, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * Record blocks given back to a pool allocator.
+   *
+   * @param count The amount of blocks.
+   */
+  inline void record_block_free(size_t count = 1) {
+#if SM_ALLOCATOR_STATS
+    current_frame.free_count.fetch_add(count, std::memory_order_relaxed);
+#endif
+  }
+
+  /**
+   * Poison memory that was released, if poison_on_reset is enabled.
+   *
+   * @param memory The start of the released memory.
+   * @param size The size of the released memory in bytes.
+   */
+  inline void poison(void* memory, size_t size) {
+    if(!poison_on_reset || !size) { return; }
+
+    // Parts of the range may already be poisoned by an earlier rollback.
+    SM_UNPOISON_MEMORY(memory, size);
+    memset(memory, poison_byte, size);
+    SM_POISON_MEMORY(memory, size);
+  }
+
+  /**
+   * Close the current frame, its counters become last_frame. Call once per
+   * frame from the game loop.
+   */
+  inline void end_frame() {
+    last_frame.allocation_count       = current_frame.allocation_count.exchange(0, std::memory_order_relaxed);
+    last_frame.allocated_bytes        = current_frame.allocated_bytes.exchange(0, std::memory_order_relaxed);
+    last_frame.block_allocation_count = current_frame.block_allocation_count.exchange(0, std::memory_order_relaxed);
+    last_frame.free_count             = current_frame.free_count.exchange(0, std::memory_order_relaxed);
+    last_frame.reset_count            = current_frame.reset_count.exchange(0, std::memory_order_relaxed);
+    last_frame.rollback_count         = current_frame.rollback_count.exchange(0, std::memory_order_relaxed);
+  }
+
+  /**
+   * Log the stats of every tag and of the last frame.
+   */
+  inline void dump() {
+    char line[256];
+
+    int count = tag_count.load(std::memory_order_acquire);
+    for(int i = 0; i < count; i++) {
+      const TagStats& stats = tags[i];
+      snprintf(line, sizeof(line), "%-12s %8zu allocs %12zu bytes total %12zu in use %12zu peak %12zu budget",
+               stats.name, stats.allocation_count.load(), stats.allocated_bytes.load(),
+               stats.current_bytes.load(), stats.peak_bytes.load(), stats.budget_bytes.load());
+      SM_CINFO(allocator, "{}", line);
+    }
+
+    snprintf(line, sizeof(line),
+             "last frame: %zu allocs, %zu bytes, %zu pool blocks, %zu frees, %zu resets, %zu rollbacks",
+             last_frame.allocation_count, last_frame.allocated_bytes, last_frame.block_allocation_count,
+             last_frame.free_count, last_frame.reset_count, last_frame.rollback_count);
+    SM_CINFO(allocator, "{}", line);
+  }
+}  // namespace allocator_stats
+
+#endif  // _ALLOCATOR_STATS_HPP
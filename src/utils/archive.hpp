@@ -0,0 +1,180 @@
+#pragma once
+#ifndef _ARCHIVE_HPP
+#define _ARCHIVE_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "utils.hpp"
+
+/**
+ * Packed asset archive: one file holding every asset, built by the
+ * pack_assets tool and mapped read-only at runtime.
+ *
+ * Layout, little endian:
+ *   Header                    magic, entry count and slot count
+ *   Entry[slot_count]         open addressing hash table of the assets, hash 0 marks an empty slot
+ *   blobs                     the assets, each one aligned to blob_alignment from the start of the file
+ *
+ * Assets are looked up by the hash of their path relative to the packed
+ * directory, with '/' separators, which can be computed at compile time.
+ */
+namespace archive {
+  /**
+   * Identifies the file format and its version.
+   */
+  inline constexpr char magic[8] = {'S', 'M', 'P', 'A', 'K', '\0', '\0', '\1'};
+
+  /**
+   * Alignment of every asset in the file, and so in memory once mapped.
+   */
+  inline constexpr size_t blob_alignment = 64;
+
+  /**
+   * Start of an archive.
+   */
+  struct Header {
+    char magic[8];         // archive::magic
+    uint32_t entry_count;  // amount of assets
+    uint32_t slot_count;   // amount of hash table slots, a power of two
+  };
+
+  /**
+   * Hash table slot, describes one asset.
+   */
+  struct Entry {
+    uint64_t hash;    // hash of the asset name, 0 for an empty slot
+    uint64_t offset;  // offset of the asset from the start of the file
+    uint64_t size;    // size of the asset in bytes
+  };
+
+  /**
+   * An asset inside a mapped archive, valid until the archive is closed.
+   */
+  struct AssetView {
+    const char* data;  // the contents, nullptr if the asset isn't in the archive
+    size_t size;       // size of the contents in bytes
+  };
+
+  /**
+   * A mapped archive.
+   */
+  struct Archive {
+    utils::FileView view;     // the whole file
+    const Entry* slots;       // the hash table
+    uint64_t slot_mask;       // slot_count - 1
+    utils::file_error error;  // file_error::none if the archive is open
+  };
+
+  /**
+   * Hash an asset name, 64-bit FNV-1a. Never 0, which marks empty slots.
+   *
+   * @param name The name of the asset, its path relative to the packed directory with '/' separators.
+   * @return The hash of the name.
+   */
+  constexpr uint64_t hash_name(const char* name) {
+    uint64_t hash = 14695981039346656037ull;
+    for(; *name; name++) { hash = (hash ^ (unsigned char)*name) * 1099511628211ull; }
+
+    return hash ? hash : 1;
+  }
+
+  /**
+   * Get the amount of hash table slots for an amount of assets, the table is
+   * kept at most half full so probes stay short.
+   *
+   * @param entry_count The amount of assets.
+   * @return The amount of slots, a power of two.
+   */
+  constexpr uint32_t get_slot_count(uint32_t entry_count) {
+    uint32_t slot_count = 1;
+    while(slot_count < entry_count * 2) { slot_count <<= 1; }
+
+    return slot_count;
+  }
+
+  /**
+   * Map an archive and check its header and table. The file isn't read, its
+   * pages are loaded when the assets are first touched.
+   *
+   * @param file_path The path to the archive.
+   * @return The archive, check its error.
+   */
+  inline Archive open_archive(const char* file_path) {
+    Archive archive = {};
+
+    archive.view = utils::map_file(file_path, utils::access_hint::random);
+    if(archive.view.error != utils::file_error::none) {
+      archive.error = archive.view.error;
+      return archive;
+    }
+
+    const Header* header = (const Header*)archive.view.data;
+    bool valid           = archive.view.size >= sizeof(Header) && memcmp(header->magic, magic, sizeof(magic)) == 0;
+    valid                = valid && header->slot_count && (header->slot_count & (header->slot_count - 1)) == 0;
+    valid                = valid && header->slot_count <= (archive.view.size - sizeof(Header)) / sizeof(Entry);
+
+    if(valid) {
+      archive.slots     = (const Entry*)(archive.view.data + sizeof(Header));
+      archive.slot_mask = header->slot_count - 1;
+
+      // Check the bounds once so lookups don't have to, and that an empty slot ends every probe.
+      uint64_t used = 0;
+      for(uint64_t i = 0; i <= archive.slot_mask && valid; i++) {
+        const Entry& entry = archive.slots[i];
+        if(!entry.hash) { continue; }
+
+        used++;
+        valid = entry.offset <= archive.view.size && entry.size <= archive.view.size - entry.offset;
+      }
+      valid = valid && used == header->entry_count && used < header->slot_count;
+    }
+
+    if(!valid) {
+      utils::unmap_file(&archive.view);
+      archive       = {};
+      archive.error = utils::file_error::read_failed;
+    }
+
+    return archive;
+  }
+
+  /**
+   * Unmap an archive, views of its assets must not be used anymore.
+   *
+   * @param archive The archive to close.
+   */
+  inline void close_archive(Archive* archive) {
+    utils::unmap_file(&archive->view);
+    *archive = {};
+  }
+
+  /**
+   * Find an asset in an archive, without copying it.
+   *
+   * @param archive The archive to search.
+   * @param hash The hash of the asset name, see hash_name.
+   * @return The asset, data is nullptr if it isn't in the archive.
+   */
+  inline AssetView find_asset(const Archive* archive, uint64_t hash) {
+    if(!archive->slots) { return {nullptr, 0}; }
+
+    for(uint64_t slot = hash & archive->slot_mask;; slot = (slot + 1) & archive->slot_mask) {
+      const Entry& entry = archive->slots[slot];
+      if(entry.hash == hash) { return {archive->view.data + entry.offset, (size_t)entry.size}; }
+      if(!entry.hash) { return {nullptr, 0}; }
+    }
+  }
+
+  /**
+   * Find an asset in an archive by name, without copying it.
+   *
+   * @param archive The archive to search.
+   * @param name The name of the asset, its path relative to the packed directory with '/' separators.
+   * @return The asset, data is nullptr if it isn't in the archive.
+   */
+  inline AssetView find_asset(const Archive* archive, const char* name) { return find_asset(archive, hash_name(name)); }
+}  // namespace archive
+
+#endif  // _ARCHIVE_HPP
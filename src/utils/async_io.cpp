@@ -0,0 +1,263 @@
+#include "async_io.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "logger.hpp"
+
+namespace async_io {
+  namespace {
+    /**
+     * A file waiting to be read by an I/O thread.
+     */
+    struct Request {
+      char path[max_path_length];  // the path to the file to read
+      char* buffer;                // where to read the file to, nullptr to allocate it with malloc
+      size_t capacity;             // size of the buffer in bytes
+      completion callback;         // called on the main thread once the file was read
+      void* user_data;             // passed to the callback
+    };
+
+    /**
+     * A read file waiting for end_frame to run its completion.
+     */
+    struct Completion {
+      utils::FileResult result;  // the contents, their size and the error
+      completion callback;       // the callback of the request
+      void* user_data;           // passed to the callback
+    };
+
+    // Queued requests, a ring buffer. Never more than max_requests since that many can be in flight.
+    std::mutex request_mutex;
+    std::condition_variable request_ready;
+    Request requests[max_requests];
+    size_t request_head  = 0;
+    size_t request_count = 0;
+    bool running         = false;
+
+    std::thread workers[max_threads];
+    size_t worker_count = 0;
+
+    // Finished requests, end_frame swaps the two lists so the I/O threads can keep finishing requests.
+    std::mutex completion_mutex;
+    Completion completions[2][max_requests];
+    size_t completion_list  = 0;
+    size_t completion_count = 0;
+
+    std::atomic<size_t> pending{0};
+
+    /**
+     * Read a whole file into memory allocated with malloc.
+     *
+     * @param file_path The path to the file to read.
+     * @return The contents, their size and the error.
+     */
+    utils::FileResult read_to_heap(const char* file_path) {
+      utils::OpenFile file = utils::open_file(file_path);
+      if(file.error != utils::file_error::none) { return {nullptr, 0, file.error}; }
+
+      char* data = (char*)malloc(file.size + 1);
+      if(!data) {
+        utils::close_file(&file);
+        return {nullptr, file.size, utils::file_error::out_of_memory};
+      }
+
+      bool read = utils::read_contents(&file, data);
+      utils::close_file(&file);
+
+      if(!read) {
+        free(data);
+        return {nullptr, 0, utils::file_error::read_failed};
+      }
+
+      data[file.size] = '\0';
+      return {data, file.size, utils::file_error::none};
+    }
+
+    /**
+     * Read the file of a request and hand the result to end_frame.
+     *
+     * @param request The request to serve.
+     */
+    void serve(const Request& request) {
+      utils::FileResult result = request.buffer ? utils::read_file(request.path, request.buffer, request.capacity)
+                                                : read_to_heap(request.path);
+
+      if(result.error != utils::file_error::none) {
+        SM_CWARN(io, "Failed to read {}, error {}.", request.path, (int)result.error);
+      }
+
+      std::lock_guard<std::mutex> lock(completion_mutex);
+      completions[completion_list][completion_count++] = {result, request.callback, request.user_data};
+    }
+
+    /**
+     * I/O thread: serve requests until stopped and every queued request was
+     * served.
+     */
+    void work() {
+      while(true) {
+        Request request;
+        {
+          std::unique_lock<std::mutex> lock(request_mutex);
+          request_ready.wait(lock, [] { return request_count > 0 || !running; });
+          if(request_count == 0) { return; }
+
+          request      = requests[request_head];
+          request_head = (request_head + 1) % max_requests;
+          request_count--;
+        }
+
+        serve(request);
+      }
+    }
+
+    /**
+     * Queue a request, or serve it on the caller if the I/O threads aren't
+     * running.
+     *
+     * @param file_path The path to the file to read.
+     * @param buffer Where to read the file to, nullptr to allocate it with malloc.
+     * @param capacity Size of the buffer in bytes.
+     * @param callback Called on the main thread once the file was read.
+     * @param user_data Passed to the callback.
+     * @return Whether or not the request was queued.
+     */
+    bool submit(const char* file_path, char* buffer, size_t capacity, completion callback, void* user_data) {
+      size_t length = strlen(file_path);
+      if(length >= max_path_length) {
+        SM_CERROR(io, "Failed to queue {}, the path is longer than {} bytes.", file_path, max_path_length - 1);
+        return false;
+      }
+
+      if(pending.fetch_add(1) >= max_requests) {
+        pending.fetch_sub(1);
+        SM_CWARN(io, "Failed to queue {}, {} requests are already in flight.", file_path, max_requests);
+        return false;
+      }
+
+      Request request = {};
+      memcpy(request.path, file_path, length + 1);
+      request.buffer    = buffer;
+      request.capacity  = capacity;
+      request.callback  = callback;
+      request.user_data = user_data;
+
+      {
+        std::lock_guard<std::mutex> lock(request_mutex);
+        if(running) {
+          requests[(request_head + request_count) % max_requests] = request;
+          request_count++;
+          request_ready.notify_one();
+          return true;
+        }
+      }
+
+      serve(request);
+      return true;
+    }
+  }  // namespace
+
+  /**
+   * Start the I/O threads. Until then, and after stop, requests are read on
+   * the caller but their completions still run in end_frame.
+   *
+   * @param thread_count The amount of I/O threads, up to max_threads.
+   */
+  void start(size_t thread_count) {
+    std::lock_guard<std::mutex> lock(request_mutex);
+    if(running) { return; }
+
+    if(thread_count == 0) { thread_count = 1; }
+    if(thread_count > max_threads) { thread_count = max_threads; }
+
+    running      = true;
+    worker_count = thread_count;
+    for(size_t i = 0; i < worker_count; i++) { workers[i] = std::thread(work); }
+
+    SM_CTRACE(io, "Started {} I/O threads.", worker_count);
+  }
+
+  /**
+   * Stop the I/O threads once every queued request was read, then run the
+   * remaining completions.
+   */
+  void stop() {
+    {
+      std::lock_guard<std::mutex> lock(request_mutex);
+      if(!running) { return; }
+      running = false;
+    }
+    request_ready.notify_all();
+
+    for(size_t i = 0; i < worker_count; i++) { workers[i].join(); }
+    worker_count = 0;
+
+    end_frame();
+  }
+
+  /**
+   * Queue a whole file to be read in binary mode into memory allocated with
+   * malloc, followed by a null terminator.
+   *
+   * @param file_path The path to the file to read.
+   * @param callback Called on the main thread once the file was read.
+   * @param user_data Passed to the callback.
+   * @return Whether or not the request was queued, false when max_requests are in flight.
+   */
+  bool load_file(const char* file_path, completion callback, void* user_data) {
+    return submit(file_path, nullptr, 0, callback, user_data);
+  }
+
+  /**
+   * Queue a whole file to be read in binary mode into a caller buffer,
+   * followed by a null terminator. The buffer must stay valid until the
+   * completion ran.
+   *
+   * @param file_path The path to the file to read.
+   * @param buffer The buffer to read the file into.
+   * @param capacity The size of the buffer in bytes, the file size + 1 at least.
+   * @param callback Called on the main thread once the file was read.
+   * @param user_data Passed to the callback.
+   * @return Whether or not the request was queued, false when max_requests are in flight.
+   */
+  bool load_file(const char* file_path, char* buffer, size_t capacity, completion callback, void* user_data) {
+    return submit(file_path, buffer, capacity, callback, user_data);
+  }
+
+  /**
+   * Run the completions of the requests finished since the last call, in
+   * the order they finished. Call once per frame from the main thread.
+   */
+  void end_frame() {
+    size_t list;
+    size_t count;
+    {
+      std::lock_guard<std::mutex> lock(completion_mutex);
+      list             = completion_list;
+      count            = completion_count;
+      completion_list  = 1 - completion_list;
+      completion_count = 0;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+      const Completion& done = completions[list][i];
+      if(done.callback) { done.callback(done.result, done.user_data); }
+    }
+
+    pending.fetch_sub(count);
+  }
+
+  /**
+   * Get the amount of requests in flight, queued, being read or waiting for
+   * their completion.
+   *
+   * @return The amount of requests in flight.
+   */
+  size_t pending_count() { return pending.load(); }
+}  // namespace async_io
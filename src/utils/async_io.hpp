@@ -0,0 +1,89 @@
+#pragma once
+#ifndef _ASYNC_IO_HPP
+#define _ASYNC_IO_HPP
+
+#include <stddef.h>
+
+#include "utils.hpp"
+
+namespace async_io {
+  /**
+   * Longest path a request can hold, including the null terminator.
+   */
+  inline constexpr size_t max_path_length = 256;
+
+  /**
+   * Most requests that can be in flight at once, from queued until their
+   * completion ran.
+   */
+  inline constexpr size_t max_requests = 256;
+
+  /**
+   * Most I/O threads.
+   */
+  inline constexpr size_t max_threads = 8;
+
+  /**
+   * Called on the main thread, in end_frame, once a file was read.
+   *
+   * @param result The contents, their size and the error. Contents read without a buffer are
+   * allocated with malloc and owned by the completion.
+   * @param user_data The pointer given with the request.
+   */
+  typedef void (*completion)(const utils::FileResult& result, void* user_data);
+
+  /**
+   * Start the I/O threads. Until then, and after stop, requests are read on
+   * the caller but their completions still run in end_frame.
+   *
+   * @param thread_count The amount of I/O threads, up to max_threads.
+   */
+  void start(size_t thread_count = 2);
+
+  /**
+   * Stop the I/O threads once every queued request was read, then run the
+   * remaining completions.
+   */
+  void stop();
+
+  /**
+   * Queue a whole file to be read in binary mode into memory allocated with
+   * malloc, followed by a null terminator.
+   *
+   * @param file_path The path to the file to read.
+   * @param callback Called on the main thread once the file was read.
+   * @param user_data Passed to the callback.
+   * @return Whether or not the request was queued, false when max_requests are in flight.
+   */
+  bool load_file(const char* file_path, completion callback, void* user_data = nullptr);
+
+  /**
+   * Queue a whole file to be read in binary mode into a caller buffer,
+   * followed by a null terminator. The buffer must stay valid until the
+   * completion ran.
+   *
+   * @param file_path The path to the file to read.
+   * @param buffer The buffer to read the file into.
+   * @param capacity The size of the buffer in bytes, the file size + 1 at least.
+   * @param callback Called on the main thread once the file was read.
+   * @param user_data Passed to the callback.
+   * @return Whether or not the request was queued, false when max_requests are in flight.
+   */
+  bool load_file(const char* file_path, char* buffer, size_t capacity, completion callback, void* user_data = nullptr);
+
+  /**
+   * Run the completions of the requests finished since the last call, in
+   * the order they finished. Call once per frame from the main thread.
+   */
+  void end_frame();
+
+  /**
+   * Get the amount of requests in flight, queued, being read or waiting for
+   * their completion.
+   *
+   * @return The amount of requests in flight.
+   */
+  size_t pending_count();
+}  // namespace async_io
+
+#endif  // _ASYNC_IO_HPP
@@ -2,19 +2,77 @@
 #ifndef _BUMP_ALLOCATOR_H
 #define _BUMP_ALLOCATOR_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "allocator_stats.hpp"
 #include "logger.hpp"
 
 namespace bump_allocator {
+  /**
+   * Alignment used when none is given, enough for any scalar type.
+   */
+  inline constexpr size_t default_alignment = alignof(max_align_t);
+
+  /**
+   * Size of a cache line, use it as the alignment for per-thread data.
+   */
+  inline constexpr size_t cache_line_size = 64;
+
+  /**
+   * Granularity in which virtual memory allocators commit pages, a multiple
+   * of the page size on every platform we ship on.
+   */
+  inline constexpr size_t virtual_commit_size = 64 * 1024;
+
   /**
    * Struct to save the state of the bump allocator.
    */
   struct BumpAllocator {
+    void* memory;            // pointer to the memory
+    size_t used;             // in bytes
+    size_t capacity;         // in bytes, the committed part for virtual memory allocators
+    size_t reserved;         // in bytes, the reserved address range, 0 for malloc backed allocators
+    bool decommit_on_reset;  // whether reset gives the committed pages back to the OS
+    bool borrowed_memory;    // whether the memory belongs to a parent allocator and must not be freed
+    size_t peak;             // in bytes, the highest used seen
+    int tag;                 // index of the allocator_stats tag, 0 if untagged
+  };
+
+  /**
+   * Bump allocator that can be shared between threads. Allocation is a single
+   * atomic fetch-add, there is no lock and no way to roll back, only reset
+   * once every thread stopped allocating.
+   */
+  struct ConcurrentBumpAllocator {
     void* memory;     // pointer to the memory
-    size_t used;      // in bytes
     size_t capacity;  // in bytes
+    int tag;          // index of the allocator_stats tag, 0 if untagged
+
+    alignas(cache_line_size) std::atomic<size_t> used;  // in bytes, on its own cache line, past capacity once full
+    std::atomic<size_t> failed_offset;                  // offset of the first claim that didn't fit, SIZE_MAX if none
+  };
+
+  /**
+   * A saved position inside a bump allocator. Rolling back to a marker
+   * releases everything that was allocated after it was taken.
+   */
+  struct Marker {
+    size_t used;  // in bytes
   };
 
   /**
@@ -23,42 +81,460 @@ namespace bump_allocator {
    * @param size The size of the allocator in bytes.
    * @return The bump allocator.
    */
-  BumpAllocator create_allocator(size_t size) {
-    BumpAllocator allocator;
-    allocator.memory   = malloc(size);
-    allocator.used     = 0;
-    allocator.capacity = size;
+  inline BumpAllocator create_allocator(size_t size) {
+    BumpAllocator allocator = {};
+    allocator.memory        = malloc(size);
+    allocator.used          = 0;
+    allocator.capacity      = size;
 
     // If we can manage to allocate the memory, log it.
     if(allocator.memory) {
-      SM_TRACE("Successfully allocated {} bytes of memory for the bump allocator.", size);
+      SM_CTRACE(allocator, "Successfully allocated {} bytes of memory for the bump allocator.", size);
+    } else {
+      SM_CERROR(allocator, "Failed to allocate {} bytes of memory for the bump allocator.", size);
+    }
+
+    return allocator;
+  }
+
+  /**
+   * Create a bump allocator backed by virtual memory. The whole address range
+   * is reserved up front and pages are committed on demand, so pointers stay
+   * stable and untouched capacity uses no physical memory.
+   *
+   * @param size The size of the address range to reserve in bytes.
+   * @param decommit_on_reset Whether reset gives the committed pages back to the OS.
+   * @return The bump allocator.
+   */
+  inline BumpAllocator create_virtual_allocator(size_t size, bool decommit_on_reset = false) {
+    size = (size + virtual_commit_size - 1) & ~(virtual_commit_size - 1);
+
+    BumpAllocator allocator     = {};
+    allocator.decommit_on_reset = decommit_on_reset;
+
+#ifdef _WIN32
+    allocator.memory = VirtualAlloc(nullptr, size, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    allocator.memory = mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if(allocator.memory == MAP_FAILED) { allocator.memory = nullptr; }
+#endif
+
+    if(allocator.memory) {
+      allocator.reserved = size;
+      SM_CTRACE(allocator, "Successfully reserved {} bytes of address space for the bump allocator.", size);
     } else {
-      SM_ERROR("Failed to allocate {} bytes of memory for the bump allocator.", size);
+      SM_CERROR(allocator, "Failed to reserve {} bytes of address space for the bump allocator.", size);
     }
 
     return allocator;
   }
 
+  /**
+   * Commit pages of a virtual memory allocator until at least `size` bytes
+   * are usable.
+   *
+   * @param allocator The allocator to commit memory for.
+   * @param size The amount of bytes that must be committed.
+   * @return Whether or not the memory could be committed.
+   */
+  inline bool commit(BumpAllocator* allocator, size_t size) {
+    if(size <= allocator->capacity) { return true; }
+    if(size > allocator->reserved) { return false; }
+
+    size_t new_capacity = (size + virtual_commit_size - 1) & ~(virtual_commit_size - 1);
+    if(new_capacity > allocator->reserved) { new_capacity = allocator->reserved; }
+
+    char* start   = (char*)allocator->memory + allocator->capacity;
+    size_t length = new_capacity - allocator->capacity;
+
+#ifdef _WIN32
+    if(!VirtualAlloc(start, length, MEM_COMMIT, PAGE_READWRITE)) { return false; }
+#else
+    if(mprotect(start, length, PROT_READ | PROT_WRITE) != 0) { return false; }
+#endif
+
+    allocator->capacity = new_capacity;
+    return true;
+  }
+
+  /**
+   * Give the committed pages past the used part of a virtual memory allocator
+   * back to the OS. Does nothing for malloc backed allocators.
+   *
+   * @param allocator The allocator to trim.
+   */
+  inline void decommit(BumpAllocator* allocator) {
+    if(!allocator->reserved) { return; }
+
+    size_t keep = (allocator->used + virtual_commit_size - 1) & ~(virtual_commit_size - 1);
+    if(keep >= allocator->capacity) { return; }
+
+    char* start   = (char*)allocator->memory + keep;
+    size_t length = allocator->capacity - keep;
+
+#ifdef _WIN32
+    VirtualFree(start, length, MEM_DECOMMIT);
+#else
+    madvise(start, length, MADV_DONTNEED);
+    mprotect(start, length, PROT_NONE);
+#endif
+
+    allocator->capacity = keep;
+  }
+
+  /**
+   * Release the memory of a bump allocator. Every pointer handed out by it
+   * becomes invalid.
+   *
+   * @param allocator The allocator to destroy.
+   */
+  inline void destroy_allocator(BumpAllocator* allocator) {
+    if(allocator->reserved) {
+#ifdef _WIN32
+      VirtualFree(allocator->memory, 0, MEM_RELEASE);
+#else
+      munmap(allocator->memory, allocator->reserved);
+#endif
+    } else if(!allocator->borrowed_memory) {
+      free(allocator->memory);
+    }
+
+    if(!allocator->borrowed_memory) { allocator_stats::record_release(allocator->tag, allocator->used); }
+
+    *allocator = {};
+  }
+
   /**
    * Allocate memory from the bump allocator.
    *
    * @param allocator The allocator to allocate memory from.
    * @param size The size of the memory to allocate.
+   * @param alignment The alignment of the memory, must be a power of two.
    * @return The pointer to the allocated memory.
    */
-  void* allocate(BumpAllocator* allocator, size_t size) {
-    // If we don't have enough memory, log it.
-    if(allocator->used + size > allocator->capacity) {
-      SM_ERROR("Failed to allocate {} bytes of memory from the bump allocator, not enough memory.", size);
+  inline void* allocate(BumpAllocator* allocator, size_t size, size_t alignment = default_alignment) {
+    SM_ASSERT(alignment && !(alignment & (alignment - 1)), "Bump allocator alignment must be a power of two.");
+
+    // Pad the current position up to the alignment, based on the actual address.
+    uintptr_t current = (uintptr_t)allocator->memory + allocator->used;
+    size_t padding    = (size_t)(((current + alignment - 1) & ~(uintptr_t)(alignment - 1)) - current);
+
+    // If we don't have enough memory (and can't commit more), log it.
+    size_t required = allocator->used + padding + size;
+    if(required > allocator->capacity && !commit(allocator, required)) {
+      SM_CERROR(allocator, "Failed to allocate {} bytes of memory from the bump allocator, not enough memory.", size);
       return nullptr;
     }
 
     // Allocate the memory.
-    void* memory = (char*)allocator->memory + allocator->used;
-    allocator->used += size;
+    void* memory = (char*)allocator->memory + allocator->used + padding;
+    allocator->used += padding + size;
+
+#if SM_ALLOCATOR_STATS
+    if(allocator->used > allocator->peak) { allocator->peak = allocator->used; }
+
+    // Sub allocators are accounted once, when carved, and stay free of shared writes for their thread.
+    if(!allocator->borrowed_memory) { allocator_stats::record_allocation(allocator->tag, padding + size); }
+#endif
+    SM_UNPOISON_MEMORY(memory, size);
 
     return memory;
   }
+
+  /**
+   * Allocate uninitialized memory for `count` objects of type T, aligned to
+   * alignof(T).
+   *
+   * @param allocator The allocator to allocate memory from.
+   * @param count The amount of objects to allocate.
+   * @return The pointer to the first object.
+   */
+  template <typename T>
+  T* allocate(BumpAllocator* allocator, size_t count = 1) {
+    return (T*)allocate(allocator, sizeof(T) * count, alignof(T));
+  }
+
+  /**
+   * Allocate and value-initialize an array of `count` objects of type T. The
+   * allocator never runs destructors, so T must be trivially destructible.
+   *
+   * @param allocator The allocator to allocate memory from.
+   * @param count The amount of objects in the array.
+   * @return The pointer to the first object.
+   */
+  template <typename T>
+  T* allocate_array(BumpAllocator* allocator, size_t count) {
+    static_assert(std::is_trivially_destructible<T>::value, "Bump allocated objects are never destroyed.");
+
+    T* array = allocate<T>(allocator, count);
+    if(!array) { return nullptr; }
+
+    for(size_t i = 0; i < count; i++) { new(array + i) T(); }
+
+    return array;
+  }
+
+  /**
+   * Release everything allocated from the bump allocator in O(1). Meant to be
+   * called once per frame on transient (per-frame scratch) allocators. Virtual
+   * memory allocators created with decommit_on_reset also give their pages
+   * back to the OS, which is not O(1).
+   *
+   * @param allocator The allocator to reset.
+   */
+  inline void reset(BumpAllocator* allocator) {
+    if(!allocator->borrowed_memory) { allocator_stats::record_reset(allocator->tag, allocator->used); }
+    allocator_stats::poison(allocator->memory, allocator->used);
+
+    allocator->used = 0;
+
+    if(allocator->decommit_on_reset) { decommit(allocator); }
+  }
+
+  /**
+   * Save the current position of the bump allocator.
+   *
+   * @param allocator The allocator to save the position of.
+   * @return The marker to roll back to.
+   */
+  inline Marker get_marker(BumpAllocator* allocator) { return Marker{allocator->used}; }
+
+  /**
+   * Roll the bump allocator back to a marker, releasing everything that was
+   * allocated after the marker was taken.
+   *
+   * @param allocator The allocator to roll back.
+   * @param marker The marker returned by get_marker.
+   */
+  inline void rollback(BumpAllocator* allocator, Marker marker) {
+    SM_ASSERT(marker.used <= allocator->used, "Rolling back to a marker that is ahead of the bump allocator.");
+
+    if(!allocator->borrowed_memory) { allocator_stats::record_rollback(allocator->tag, allocator->used - marker.used); }
+    allocator_stats::poison((char*)allocator->memory + marker.used, allocator->used - marker.used);
+
+    allocator->used = marker.used;
+  }
+
+  /**
+   * Marker that rolls the allocator back when it goes out of scope, so nested
+   * temporary allocations are released in LIFO order.
+   */
+  struct ScopedMarker {
+    BumpAllocator* allocator;
+    Marker marker;
+
+    explicit ScopedMarker(BumpAllocator* target) : allocator(target), marker(get_marker(target)) {}
+    ~ScopedMarker() { rollback(allocator, marker); }
+
+    ScopedMarker(const ScopedMarker&)            = delete;
+    ScopedMarker& operator=(const ScopedMarker&) = delete;
+  };
+
+  /**
+   * Account the allocations of a bump allocator to a tag, e.g. "level",
+   * "render" or "audio". Allocators sharing a tag share its budget.
+   *
+   * @param allocator The allocator to tag.
+   * @param tag The name of the tag, must outlive the program (a string literal).
+   */
+  inline void set_tag(BumpAllocator* allocator, const char* tag) {
+    int index = allocator_stats::register_tag(tag);
+
+    // Move the bytes already in use over to the new tag, sub allocators are accounted to their parent.
+    if(!allocator->borrowed_memory) {
+      allocator_stats::record_release(allocator->tag, allocator->used);
+      allocator_stats::record_acquire(index, allocator->used);
+    }
+
+    allocator->tag = index;
+  }
+
+  /**
+   * Log the usage of a bump allocator.
+   *
+   * @param allocator The allocator to log.
+   */
+  inline void dump(BumpAllocator* allocator) {
+    char line[256];
+    snprintf(line, sizeof(line), "%-12s %12zu used %12zu peak %12zu capacity %12zu reserved",
+             allocator_stats::tags[allocator->tag].name, allocator->used, allocator->peak, allocator->capacity,
+             allocator->reserved);
+    SM_CINFO(allocator, "{}", line);
+  }
+
+  /**
+   * Create a bump allocator that can be shared between threads.
+   *
+   * @param size The size of the allocator in bytes.
+   * @return The concurrent bump allocator.
+   */
+  inline ConcurrentBumpAllocator create_concurrent_allocator(size_t size) {
+    void* memory = malloc(size);
+
+    // If we can manage to allocate the memory, log it.
+    if(memory) {
+      SM_CTRACE(allocator, "Successfully allocated {} bytes of memory for the concurrent bump allocator.", size);
+    } else {
+      SM_CERROR(allocator, "Failed to allocate {} bytes of memory for the concurrent bump allocator.", size);
+      size = 0;
+    }
+
+    return {memory, size, 0, {0}, {SIZE_MAX}};
+  }
+
+  /**
+   * Get the bytes claimed from a concurrent bump allocator by the allocations
+   * that fit. Claims are handed out in order, so every claim past the first
+   * one that didn't fit failed too.
+   *
+   * @param allocator The allocator.
+   * @return The claimed bytes.
+   */
+  inline size_t get_claimed(ConcurrentBumpAllocator* allocator) {
+    size_t used = allocator->used.load(std::memory_order_relaxed);
+    return used <= allocator->capacity ? used : allocator->failed_offset.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Release the memory of a concurrent bump allocator. No thread may use it,
+   * or any sub allocator carved from it, anymore.
+   *
+   * @param allocator The allocator to destroy.
+   */
+  inline void destroy_allocator(ConcurrentBumpAllocator* allocator) {
+    allocator_stats::record_release(allocator->tag, get_claimed(allocator));
+    free(allocator->memory);
+
+    allocator->memory   = nullptr;
+    allocator->capacity = 0;
+    allocator->tag      = 0;
+    allocator->used.store(0, std::memory_order_relaxed);
+    allocator->failed_offset.store(SIZE_MAX, std::memory_order_relaxed);
+  }
+
+  /**
+   * Allocate memory from the concurrent bump allocator, safe to call from any
+   * thread. Sizes are rounded up to default_alignment so that the common case
+   * needs no padding and stays a single fetch-add, besides the stats.
+   *
+   * @param allocator The allocator to allocate memory from.
+   * @param size The size of the memory to allocate.
+   * @param alignment The alignment of the memory, must be a power of two.
+   * @return The pointer to the allocated memory.
+   */
+  inline void* allocate(ConcurrentBumpAllocator* allocator, size_t size, size_t alignment = default_alignment) {
+    SM_ASSERT(alignment && !(alignment & (alignment - 1)), "Bump allocator alignment must be a power of two.");
+
+    // Over-claim by the worst case padding, the aligned block always fits in the claimed range.
+    size_t claim = (size + default_alignment - 1) & ~(default_alignment - 1);
+    if(alignment > default_alignment) { claim += alignment - default_alignment; }
+
+    size_t offset = allocator->used.fetch_add(claim, std::memory_order_relaxed);
+
+    // If we don't have enough memory, log it.
+    if(offset + claim > allocator->capacity) {
+      // Failing claims may finish out of order, keep the lowest offset.
+      size_t failed = allocator->failed_offset.load(std::memory_order_relaxed);
+      while(offset < failed &&
+            !allocator->failed_offset.compare_exchange_weak(failed, offset, std::memory_order_relaxed)) {}
+
+      SM_CERROR(allocator, "Failed to allocate {} bytes from the concurrent bump allocator, not enough memory.", size);
+      return nullptr;
+    }
+
+    allocator_stats::record_allocation(allocator->tag, claim);
+
+    uintptr_t current = (uintptr_t)allocator->memory + offset;
+    return (void*)((current + alignment - 1) & ~(uintptr_t)(alignment - 1));
+  }
+
+  /**
+   * Allocate uninitialized memory for `count` objects of type T from the
+   * concurrent bump allocator, aligned to alignof(T).
+   *
+   * @param allocator The allocator to allocate memory from.
+   * @param count The amount of objects to allocate.
+   * @return The pointer to the first object.
+   */
+  template <typename T>
+  T* allocate(ConcurrentBumpAllocator* allocator, size_t count = 1) {
+    return (T*)allocate(allocator, sizeof(T) * count, alignof(T));
+  }
+
+  /**
+   * Release everything allocated from the concurrent bump allocator. Only
+   * call this while no thread is allocating from it.
+   *
+   * @param allocator The allocator to reset.
+   */
+  inline void reset(ConcurrentBumpAllocator* allocator) {
+    allocator_stats::record_reset(allocator->tag, get_claimed(allocator));
+
+    allocator->used.store(0, std::memory_order_relaxed);
+    allocator->failed_offset.store(SIZE_MAX, std::memory_order_relaxed);
+  }
+
+  /**
+   * Account the allocations of a concurrent bump allocator, and of the sub
+   * allocators carved from it, to a tag. Only call this while no thread is
+   * allocating from it.
+   *
+   * @param allocator The allocator to tag.
+   * @param tag The name of the tag, must outlive the program (a string literal).
+   */
+  inline void set_tag(ConcurrentBumpAllocator* allocator, const char* tag) {
+    int index = allocator_stats::register_tag(tag);
+
+    // Move the bytes already in use over to the new tag.
+    size_t claimed = get_claimed(allocator);
+    allocator_stats::record_release(allocator->tag, claimed);
+    allocator_stats::record_acquire(index, claimed);
+
+    allocator->tag = index;
+  }
+
+  /**
+   * Carve a sub allocator out of a shared parent. The sub allocator is a plain
+   * BumpAllocator owned by a single thread, so its allocations need no
+   * atomics. It covers whole cache lines to avoid false sharing and its
+   * memory is released together with the parent. The whole sub allocator is
+   * accounted to the tag of the parent when carved.
+   *
+   * @param parent The allocator to take the memory from.
+   * @param size The size of the sub allocator in bytes.
+   * @return The sub allocator, with no memory if the parent is full.
+   */
+  inline BumpAllocator create_sub_allocator(ConcurrentBumpAllocator* parent, size_t size) {
+    size = (size + cache_line_size - 1) & ~(cache_line_size - 1);
+
+    BumpAllocator allocator   = {};
+    allocator.memory          = allocate(parent, size, cache_line_size);
+    allocator.capacity        = allocator.memory ? size : 0;
+    allocator.borrowed_memory = true;
+    allocator.tag             = parent->tag;
+
+    return allocator;
+  }
+
+  /**
+   * Carve a sub allocator out of a single threaded parent, for example to hand
+   * a fixed budget to a worker before it starts.
+   *
+   * @param parent The allocator to take the memory from.
+   * @param size The size of the sub allocator in bytes.
+   * @return The sub allocator, with no memory if the parent is full.
+   */
+  inline BumpAllocator create_sub_allocator(BumpAllocator* parent, size_t size) {
+    size = (size + cache_line_size - 1) & ~(cache_line_size - 1);
+
+    BumpAllocator allocator   = {};
+    allocator.memory          = allocate(parent, size, cache_line_size);
+    allocator.capacity        = allocator.memory ? size : 0;
+    allocator.borrowed_memory = true;
+    allocator.tag             = parent->tag;
+
+    return allocator;
+  }
 }  // namespace bump_allocator
 
-#endif  // _BUMP_ALLOCATOR_H
\ No newline at end of file
+#endif  // _BUMP_ALLOCATOR_H
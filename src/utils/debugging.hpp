@@ -4,7 +4,7 @@
 
 #include <stdio.h>
 
-#include <stdexcept>
+#include "logger.hpp"
 
 namespace debugging {
   /**
@@ -17,16 +17,28 @@ namespace debugging {
    *
    * @param mode The mode to set the debug mode to.
    */
-  void set_debug_mode(bool mode) { debug_mode = mode; }
+  inline void set_debug_mode(bool mode) { debug_mode = mode; }
 
   /**
-   * Save debug information to a file.
+   * Save debug information to a file: the records kept by the logger's
+   * history ring, oldest first. Nothing outside of debug mode.
    */
-  void save_debug_info() {
+  inline void save_debug_info() {
     if(!debug_mode) return;
 
-    throw std::runtime_error("Not implemented.");
+    FILE* file = fopen("debug_info.log", "w");
+    if(!file) { return; }
+
+    fprintf(file, "Last %zu log records, prefixed by their frame number:\n", logger::history_capacity);
+    logger::dump_history(file);
+
+    fclose(file);
   }
+
+  /**
+   * Save debug information automatically when the process crashes.
+   */
+  inline void save_debug_info_on_crash() { logger::set_crash_callback(save_debug_info); }
 }  // namespace debugging
 
-#endif  // _DEBUGGING_HPP
\ No newline at end of file
+#endif  // _DEBUGGING_HPP
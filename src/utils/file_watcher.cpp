@@ -0,0 +1,453 @@
+#include "file_watcher.hpp"
+
+#include <string.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "logger.hpp"
+#include "utils.hpp"
+
+namespace file_watcher {
+  namespace {
+    /**
+     * A directory holding watched files.
+     */
+    struct Directory {
+      char path[max_path_length];  // the path of the directory
+      int descriptor;              // inotify watch descriptor, -1 while not watched
+    };
+
+    /**
+     * A watched file.
+     */
+    struct WatchedFile {
+      char path[max_path_length];  // the path the file was watched with
+      const char* name;            // the file name, inside path
+      size_t directory;            // index of the directory holding the file
+      long long timestamp;         // last modification time seen, when polling
+      bool changed;                // whether or not the file is in the pending changes
+    };
+
+    // Everything below is guarded by the mutex, the paths never change once added.
+    std::mutex mutex;
+    Directory directories[max_directories];
+    size_t directory_count = 0;
+    WatchedFile files[max_files];
+    size_t file_count = 0;
+
+    // Files changed since the last end_frame, each one once.
+    size_t pending[max_files];
+    size_t pending_count = 0;
+
+    // The list handed out by end_frame, owned by the main thread.
+    const char* changed_paths[max_files];
+
+    // Open addressing hash tables of the files and directories keyed by path, so watch_file finds duplicates and
+    // shared directories without scanning. Hold indices + 1, 0 marks an empty slot. At most half full.
+    const size_t file_slot_count      = max_files * 2;
+    const size_t directory_slot_count = max_directories * 2;
+    uint32_t path_slots[file_slot_count];
+    uint32_t directory_slots[directory_slot_count];
+
+    std::atomic<bool> running{false};
+    std::thread watcher;
+
+#ifdef __linux__
+    int inotify = -1;
+
+    // Written and closed, or renamed over, the two ways editors save, and the directory itself moving away.
+    const uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVE_SELF;
+
+    // How often directories that aren't watched, missing or removed, are tried again.
+    const std::chrono::milliseconds retry_interval(500);
+
+    // Open addressing hash table of the files in watched directories, keyed by watch descriptor and file name.
+    // Holds file indices + 1, 0 marks an empty slot. At most half full.
+    uint32_t file_slots[file_slot_count];
+#else
+    const std::chrono::milliseconds poll_interval(250);
+#endif
+
+    /**
+     * Hash a string, 32-bit FNV-1a.
+     *
+     * @param text The string to hash.
+     * @param seed Mixed into the hash, to key by more than the string.
+     * @return The hash.
+     */
+    uint32_t hash_string(const char* text, uint32_t seed = 0) {
+      uint32_t hash = 2166136261u ^ seed;
+      for(; *text; text++) { hash = (hash ^ (unsigned char)*text) * 16777619u; }
+
+      return hash;
+    }
+
+    /**
+     * Add a file to the pending changes, unless it's there already. The mutex
+     * must be held.
+     *
+     * @param file Index of the file that changed.
+     */
+    void mark_changed(size_t file) {
+      if(files[file].changed) { return; }
+
+      files[file].changed      = true;
+      pending[pending_count++] = file;
+    }
+
+#ifdef __linux__
+    /**
+     * Get the first slot of a file in the hash table, the hash of its name
+     * seeded with its watch descriptor.
+     *
+     * @param descriptor The watch descriptor of the directory of the file.
+     * @param name The file name.
+     * @return The slot to start probing from.
+     */
+    size_t get_file_slot(int descriptor, const char* name) {
+      return hash_string(name, (uint32_t)descriptor) & (file_slot_count - 1);
+    }
+
+    /**
+     * Add a file to the hash table, if its directory is watched. The mutex
+     * must be held.
+     *
+     * @param file Index of the file.
+     */
+    void index_file(size_t file) {
+      int descriptor = directories[files[file].directory].descriptor;
+      if(descriptor == -1) { return; }
+
+      size_t slot = get_file_slot(descriptor, files[file].name);
+      while(file_slots[slot]) { slot = (slot + 1) & (file_slot_count - 1); }
+      file_slots[slot] = (uint32_t)file + 1;
+    }
+
+    /**
+     * Rebuild the hash table, after watch descriptors changed. The mutex must
+     * be held.
+     */
+    void index_files() {
+      memset(file_slots, 0, sizeof(file_slots));
+      for(size_t i = 0; i < file_count; i++) { index_file(i); }
+    }
+
+    /**
+     * Mark the files a directory event names as changed. Several directory
+     * paths can share a watch descriptor, so every match is marked. The mutex
+     * must be held.
+     *
+     * @param descriptor The watch descriptor of the event.
+     * @param name The file name of the event.
+     */
+    void mark_named(int descriptor, const char* name) {
+      for(size_t slot = get_file_slot(descriptor, name); file_slots[slot]; slot = (slot + 1) & (file_slot_count - 1)) {
+        size_t file = file_slots[slot] - 1;
+        if(directories[files[file].directory].descriptor == descriptor && strcmp(files[file].name, name) == 0) {
+          mark_changed(file);
+        }
+      }
+    }
+
+    /**
+     * Start watching a directory. The mutex must be held, and the hash table
+     * rebuilt afterwards.
+     *
+     * @param directory The directory to watch.
+     * @return Whether or not the directory is watched.
+     */
+    bool watch_directory(Directory* directory) {
+      directory->descriptor = inotify_add_watch(inotify, directory->path, watch_mask);
+      return directory->descriptor != -1;
+    }
+
+    /**
+     * Forget a watch the kernel removed, because its directory was deleted or
+     * moved away. The mutex must be held.
+     *
+     * @param descriptor The removed watch descriptor.
+     */
+    void forget_watch(int descriptor) {
+      for(size_t i = 0; i < directory_count; i++) {
+        if(directories[i].descriptor != descriptor) { continue; }
+
+        directories[i].descriptor = -1;
+        SM_CTRACE(io, "Stopped watching the directory {}, watching it again once it exists.", directories[i].path);
+      }
+
+      index_files();
+    }
+
+    /**
+     * Watch the directories that aren't watched again. Their files were
+     * likely recreated with them, so the existing ones are marked as changed.
+     * The mutex must be held.
+     */
+    void retry_directories() {
+      bool watched = false;
+      for(size_t i = 0; i < directory_count; i++) {
+        if(directories[i].descriptor != -1 || !watch_directory(&directories[i])) { continue; }
+
+        watched = true;
+        SM_CTRACE(io, "Watching the directory {}.", directories[i].path);
+        for(size_t j = 0; j < file_count; j++) {
+          if(files[j].directory == i && utils::file_exists(files[j].path)) { mark_changed(j); }
+        }
+      }
+
+      if(watched) { index_files(); }
+    }
+
+    /**
+     * Background thread: wait for inotify events and turn them into pending
+     * changes.
+     */
+    void watch_events() {
+      alignas(struct inotify_event) char buffer[16384];
+      pollfd descriptor = {inotify, POLLIN, 0};
+
+      std::chrono::steady_clock::time_point last_retry = std::chrono::steady_clock::now();
+
+      while(running.load(std::memory_order_acquire)) {
+        // Wake up regularly to notice stop, and to watch missing directories once they exist.
+        bool readable = poll(&descriptor, 1, 100) > 0;
+
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if(now - last_retry >= retry_interval) {
+          last_retry = now;
+
+          std::lock_guard<std::mutex> lock(mutex);
+          retry_directories();
+        }
+
+        if(!readable) { continue; }
+
+        ssize_t length = read(inotify, buffer, sizeof(buffer));
+        if(length <= 0) { continue; }
+
+        std::lock_guard<std::mutex> lock(mutex);
+
+        for(char* next = buffer; next < buffer + length;) {
+          const inotify_event* event = (const inotify_event*)next;
+          next += sizeof(inotify_event) + event->len;
+
+          // Events were lost, anything could have changed.
+          if(event->mask & IN_Q_OVERFLOW) {
+            for(size_t i = 0; i < file_count; i++) { mark_changed(i); }
+            continue;
+          }
+
+          // The directory moved away, its path doesn't lead to it anymore. Removing the watch ends in IN_IGNORED.
+          if(event->mask & IN_MOVE_SELF) {
+            inotify_rm_watch(inotify, event->wd);
+            continue;
+          }
+
+          // The watch is gone, the directory was deleted or moved away.
+          if(event->mask & IN_IGNORED) {
+            forget_watch(event->wd);
+            continue;
+          }
+
+          if(event->len) { mark_named(event->wd, event->name); }
+        }
+      }
+    }
+#else
+    /**
+     * Background thread: compare the timestamps of the watched files and turn
+     * the differences into pending changes.
+     */
+    void poll_timestamps() {
+      while(running.load(std::memory_order_acquire)) {
+        size_t count;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          count = file_count;
+        }
+
+        for(size_t i = 0; i < count; i++) {
+          long long timestamp = utils::get_timestamp(files[i].path);
+
+          std::lock_guard<std::mutex> lock(mutex);
+          if(timestamp != files[i].timestamp) {
+            files[i].timestamp = timestamp;
+            mark_changed(i);
+          }
+        }
+
+        std::this_thread::sleep_for(poll_interval);
+      }
+    }
+#endif
+  }  // namespace
+
+  /**
+   * Start watching on a background thread. On Linux the directories of the
+   * watched files are watched with inotify, and watched again once they are
+   * recreated, elsewhere the background thread polls their timestamps.
+   *
+   * @return Whether or not the watcher started.
+   */
+  bool start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if(running.load()) { return true; }
+
+#ifdef __linux__
+    inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(inotify == -1) {
+      SM_CERROR(io, "Failed to start the file watcher, inotify is unavailable.");
+      return false;
+    }
+
+    for(size_t i = 0; i < directory_count; i++) {
+      if(!watch_directory(&directories[i])) {
+        SM_CWARN(io, "Failed to watch the directory {}, watching it once it exists.", directories[i].path);
+      }
+    }
+    index_files();
+
+    running.store(true, std::memory_order_release);
+    watcher = std::thread(watch_events);
+#else
+    running.store(true, std::memory_order_release);
+    watcher = std::thread(poll_timestamps);
+#endif
+
+    SM_CTRACE(io, "Started watching {} files in {} directories.", file_count, directory_count);
+    return true;
+  }
+
+  /**
+   * Stop watching, the watched files stay registered for the next start.
+   */
+  void stop() {
+    if(!running.load()) { return; }
+
+    running.store(false, std::memory_order_release);
+    if(watcher.joinable()) { watcher.join(); }
+
+#ifdef __linux__
+    std::lock_guard<std::mutex> lock(mutex);
+
+    close(inotify);
+    inotify = -1;
+    for(size_t i = 0; i < directory_count; i++) { directories[i].descriptor = -1; }
+#endif
+  }
+
+  /**
+   * Watch a file for changes: written and closed, or replaced by a rename as
+   * most editors save. Neither the file nor its directory have to exist yet.
+   *
+   * @param file_path The path to the file to watch.
+   * @return Whether or not the file is watched.
+   */
+  bool watch_file(const char* file_path) {
+    size_t length = strlen(file_path);
+    if(length >= max_path_length) {
+      SM_CERROR(io, "Failed to watch {}, the path is longer than {} bytes.", file_path, max_path_length - 1);
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t path_slot = hash_string(file_path) & (file_slot_count - 1);
+    for(; path_slots[path_slot]; path_slot = (path_slot + 1) & (file_slot_count - 1)) {
+      if(strcmp(files[path_slots[path_slot] - 1].path, file_path) == 0) { return true; }
+    }
+
+    if(file_count == max_files) {
+      SM_CERROR(io, "Failed to watch {}, {} files are watched already.", file_path, max_files);
+      return false;
+    }
+
+    WatchedFile& file = files[file_count];
+    memcpy(file.path, file_path, length + 1);
+    file.changed = false;
+#ifndef __linux__
+    file.timestamp = utils::get_timestamp(file.path);
+#endif
+
+    // Split the path into its directory and file name.
+    const char* separator = strrchr(file.path, '/');
+#ifdef _WIN32
+    const char* backslash = strrchr(file.path, '\\');
+    if(!separator || (backslash && backslash > separator)) { separator = backslash; }
+#endif
+    file.name = separator ? separator + 1 : file.path;
+
+    char directory_path[max_path_length] = ".";
+    if(separator) {
+      size_t directory_length = separator == file.path ? 1 : (size_t)(separator - file.path);
+      memcpy(directory_path, file.path, directory_length);
+      directory_path[directory_length] = '\0';
+    }
+
+    file.directory        = directory_count;
+    size_t directory_slot = hash_string(directory_path) & (directory_slot_count - 1);
+    for(; directory_slots[directory_slot]; directory_slot = (directory_slot + 1) & (directory_slot_count - 1)) {
+      size_t directory = directory_slots[directory_slot] - 1;
+      if(strcmp(directories[directory].path, directory_path) == 0) {
+        file.directory = directory;
+        break;
+      }
+    }
+
+    if(file.directory == directory_count) {
+      if(directory_count == max_directories) {
+        SM_CERROR(io, "Failed to watch {}, {} directories are watched already.", file_path, max_directories);
+        return false;
+      }
+
+      Directory& directory = directories[directory_count];
+      memcpy(directory.path, directory_path, sizeof(directory_path));
+      directory.descriptor = -1;
+
+#ifdef __linux__
+      if(running.load() && !watch_directory(&directory)) {
+        SM_CWARN(io, "Failed to watch the directory {}, watching it once it exists.", directory.path);
+      }
+#endif
+
+      directory_slots[directory_slot] = (uint32_t)directory_count + 1;
+      directory_count++;
+    }
+
+#ifdef __linux__
+    index_file(file_count);
+#endif
+
+    path_slots[path_slot] = (uint32_t)file_count + 1;
+    file_count++;
+    return true;
+  }
+
+  /**
+   * Get the files that changed since the previous call. Call once per frame
+   * from the main thread.
+   *
+   * @return The changed files.
+   */
+  Changes end_frame() {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    size_t count = pending_count;
+    for(size_t i = 0; i < count; i++) {
+      WatchedFile& file = files[pending[i]];
+      file.changed      = false;
+      changed_paths[i]  = file.path;
+    }
+    pending_count = 0;
+
+    return {changed_paths, count};
+  }
+}  // namespace file_watcher
@@ -0,0 +1,63 @@
+#pragma once
+#ifndef _FILE_WATCHER_HPP
+#define _FILE_WATCHER_HPP
+
+#include <stddef.h>
+
+namespace file_watcher {
+  /**
+   * Most files that can be watched.
+   */
+  inline constexpr size_t max_files = 8192;
+
+  /**
+   * Most distinct directories the watched files can be in.
+   */
+  inline constexpr size_t max_directories = 1024;
+
+  /**
+   * Longest path a watched file can have, including the null terminator.
+   */
+  inline constexpr size_t max_path_length = 256;
+
+  /**
+   * Files that changed since the previous frame, each one listed once.
+   */
+  struct Changes {
+    const char* const* paths;  // the paths the files were watched with, valid until the next end_frame
+    size_t count;              // amount of paths
+  };
+
+  /**
+   * Start watching on a background thread. On Linux the directories of the
+   * watched files are watched with inotify, and watched again once they are
+   * recreated, elsewhere the background thread polls their timestamps.
+   *
+   * @return Whether or not the watcher started.
+   */
+  bool start();
+
+  /**
+   * Stop watching, the watched files stay registered for the next start.
+   */
+  void stop();
+
+  /**
+   * Watch a file for changes: written and closed, or replaced by a rename as
+   * most editors save. Neither the file nor its directory have to exist yet.
+   *
+   * @param file_path The path to the file to watch.
+   * @return Whether or not the file is watched.
+   */
+  bool watch_file(const char* file_path);
+
+  /**
+   * Get the files that changed since the previous call. Call once per frame
+   * from the main thread.
+   *
+   * @return The changed files.
+   */
+  Changes end_frame();
+}  // namespace file_watcher
+
+#endif  // _FILE_WATCHER_HPP
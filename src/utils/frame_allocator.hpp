@@ -0,0 +1,88 @@
+#pragma once
+#ifndef _FRAME_ALLOCATOR_H
+#define _FRAME_ALLOCATOR_H
+
+#include <stddef.h>
+
+#include "bump_allocator.hpp"
+
+namespace frame_allocator {
+  /**
+   * Two transient bump allocators that alternate every frame. Frame N
+   * simulates into one of them while the render data of frame N - 1 stays
+   * valid in the other, so simulation and render submission can overlap
+   * without copying render state or taking locks.
+   *
+   * The only synchronization required is that rendering of frame N - 1 is
+   * done before swap is called at the end of frame N, since that reset hands
+   * its allocator to frame N + 1.
+   */
+  struct FrameAllocator {
+    bump_allocator::BumpAllocator allocators[2];  // indexed by frame parity
+    size_t frame;                                 // index of the frame being simulated
+  };
+
+  /**
+   * Create the double-buffered frame allocators. Both are virtual memory
+   * backed, so a heavy frame commits more pages instead of failing.
+   *
+   * @param size The size of the address range reserved for each frame in bytes.
+   * @return The frame allocator.
+   */
+  inline FrameAllocator create_frame_allocator(size_t size) {
+    FrameAllocator frame_allocator = {};
+
+    for(bump_allocator::BumpAllocator& allocator : frame_allocator.allocators) {
+      allocator = bump_allocator::create_virtual_allocator(size);
+      bump_allocator::set_tag(&allocator, "frame");
+    }
+
+    return frame_allocator;
+  }
+
+  /**
+   * Release the memory of both frame allocators.
+   *
+   * @param frame_allocator The frame allocator to destroy.
+   */
+  inline void destroy_frame_allocator(FrameAllocator* frame_allocator) {
+    for(bump_allocator::BumpAllocator& allocator : frame_allocator->allocators) {
+      bump_allocator::destroy_allocator(&allocator);
+    }
+  }
+
+  /**
+   * The allocator the frame being simulated writes into.
+   *
+   * @param frame_allocator The frame allocator.
+   * @return The allocator of the current frame.
+   */
+  inline bump_allocator::BumpAllocator* current(FrameAllocator* frame_allocator) {
+    return &frame_allocator->allocators[frame_allocator->frame & 1];
+  }
+
+  /**
+   * The allocator holding the data of the previous frame, read by the
+   * renderer while the current frame simulates.
+   *
+   * @param frame_allocator The frame allocator.
+   * @return The allocator of the previous frame.
+   */
+  inline bump_allocator::BumpAllocator* previous(FrameAllocator* frame_allocator) {
+    return &frame_allocator->allocators[(frame_allocator->frame + 1) & 1];
+  }
+
+  /**
+   * Advance to the next frame. The allocator of the frame that just finished
+   * becomes previous, and the one that held the frame before it is reset and
+   * becomes current.
+   *
+   * @param frame_allocator The frame allocator.
+   */
+  inline void swap(FrameAllocator* frame_allocator) {
+    frame_allocator->frame++;
+    bump_allocator::reset(current(frame_allocator));
+  }
+}  // namespace frame_allocator
+
+#endif  // _FRAME_ALLOCATOR_H
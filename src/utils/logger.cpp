@@ -1,66 +1,1118 @@
 #include "logger.hpp"
 
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
 namespace logger {
+  namespace {
+    /**
+     * A log record waiting in the ring buffer for the background thread.
+     */
+    struct Record {
+      CallSite* site;                // the call site that logged the record
+      const char* arg_types;         // type codes of the encoded arguments, nullptr for a text record
+      Stamp stamp;                   // when and where the record was logged
+      size_t length;                 // length of the text or payload in bytes
+      char text[max_record_length];  // the message or encoded arguments, not null terminated
+    };
+
+    /**
+     * Ring buffer slot. The sequence number tells producers and the consumer
+     * whose turn it is to touch the record (bounded MPMC queue by D. Vyukov,
+     * used here with a single consumer).
+     */
+    struct Slot {
+      std::atomic<size_t> sequence;
+      Record record;
+    };
+
+    Slot* slots      = nullptr;
+    size_t slot_mask = 0;
+
+    alignas(64) std::atomic<size_t> enqueue_position{0};
+    alignas(64) std::atomic<size_t> dequeue_position{0};
+
+    std::atomic<bool> async_running{false};
+    std::atomic<bool> consumer_running{false};
+    std::atomic<size_t> producers{0};
+    std::atomic<bool> draining{false};
+    std::atomic<size_t> dropped{0};
+    std::atomic<size_t> unreported_drops{0};
+
+    overflow_policy policy = overflow_policy::count;
+    std::thread consumer;
+
+    FILE* binary_file      = nullptr;
+    uint32_t binary_stream = 0;
+    uint32_t next_site_id  = 1;
+
+    std::atomic<uint64_t> frame_number{0};
+
+    // Call sites with suppressed records not reported yet, a lock-free stack linked by CallSite::next_listed.
+    std::atomic<CallSite*> listed_sites{nullptr};
+
+    /**
+     * Push a call site on the list of unreported sites.
+     *
+     * @param site The call site, not in the list.
+     */
+    void push_listed(CallSite* site) {
+      site->next_listed = listed_sites.load(std::memory_order_relaxed);
+      while(!listed_sites.compare_exchange_weak(site->next_listed, site, std::memory_order_release)) {}
+    }
+
+    /**
+     * Report the suppressed records of the listed call sites.
+     *
+     * @param all Whether to report every site, or only those whose rate limit window is over.
+     */
+    void report_listed(bool all) {
+      uint64_t now    = timestamp();
+      uint64_t window = get_rate_limit_window();
+
+      CallSite* site = listed_sites.exchange(nullptr, std::memory_order_acquire);
+      while(site) {
+        CallSite* next = site->next_listed;
+
+        if(all || now - site->window_start.load(std::memory_order_relaxed) >= window) {
+          // Unlisted first, so a record suppressed from here on lists the site again.
+          site->listed.store(false);
+          uint32_t count = site->suppressed.exchange(0);
+          if(count) { report_suppressed(site, count); }
+        } else {
+          push_listed(site);
+        }
+
+        site = next;
+      }
+    }
+
+    /**
+     * Reference point of the timestamps, taken when the logger is first used.
+     */
+    struct ClockBase {
+      uint64_t ticks;                              // timestamp at startup
+      std::chrono::steady_clock::time_point time;  // steady clock at startup
+    };
+
+    const ClockBase& get_clock_base() {
+      static const ClockBase base = {timestamp(), std::chrono::steady_clock::now()};
+      return base;
+    }
+
+    // Take the reference point during static initialization, so calibration rarely has to wait.
+    [[maybe_unused]] const ClockBase& startup_clock_base = get_clock_base();
+
+    /**
+     * Stamp a record being submitted by the calling thread.
+     *
+     * @return The stamp.
+     */
+    Stamp make_stamp() { return {timestamp(), frame_number.load(std::memory_order_relaxed), thread_id()}; }
+
+    HistoryRecord history[history_capacity];
+    uint64_t history_count = 0;
+
+    void (*crash_callback)() = nullptr;
+
+    /**
+     * A file mapped in memory for writing.
+     */
+    struct MappedFile {
+      char* memory;  // the mapping, nullptr if the file isn't mapped
+      size_t size;   // size of the mapping in bytes
+      size_t used;   // bytes written so far
+#ifdef _WIN32
+      HANDLE file;     // the file
+      HANDLE mapping;  // the file mapping object
+#else
+      int file;  // the file descriptor
+#endif
+    };
+
+    /**
+     * Entry of the frame index of a log file.
+     */
+    struct IndexEntry {
+      uint64_t frame;   // the frame number
+      uint64_t offset;  // offset of the first record of the frame in the log file
+    };
+
+    const size_t max_path_length   = 256;
+    const size_t index_entry_count = 64 * 1024;
+
+    char file_path[max_path_length - 16];  // room left for the rotation suffixes
+    size_t log_file_size   = 0;
+    int log_file_count     = 0;
+    MappedFile log_file    = {};
+    MappedFile index_file  = {};
+    uint64_t indexed_frame = 0;
+
+    /**
+     * How the console shows colors.
+     */
+    enum class console_mode
+    {
+      plain,  // not a terminal, no colors
+      ansi,   // ANSI escape sequences
+      win32   // console text attributes, for Windows consoles without virtual terminal support
+    };
+
+    /**
+     * ANSI escape sequences of the colors, indexed by color.
+     */
+    const char* const ansi_colors[] = {"\x1b[30m", "\x1b[34m", "\x1b[32m", "\x1b[36m", "\x1b[31m", "\x1b[35m",
+                                       "\x1b[33m", "\x1b[37m", "\x1b[90m", "\x1b[94m", "\x1b[92m", "\x1b[96m",
+                                       "\x1b[91m", "\x1b[95m", "\x1b[93m", "\x1b[97m"};
+
+    const char ansi_reset[] = "\x1b[0m";
+
+    /**
+     * Detect how the console shows colors, once. Output redirected to a file
+     * or a pipe gets no colors at all.
+     *
+     * @return The console mode.
+     */
+    console_mode get_console_mode() {
+      static const console_mode mode = [] {
+#ifdef _WIN32
+        if(!_isatty(_fileno(stdout))) { return console_mode::plain; }
+
+        HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD flags    = 0;
+        if(GetConsoleMode(console, &flags) &&
+           SetConsoleMode(console, flags | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) {
+          return console_mode::ansi;
+        }
+
+        return console_mode::win32;
+#else
+        return isatty(fileno(stdout)) ? console_mode::ansi : console_mode::plain;
+#endif
+      }();
+
+      return mode;
+    }
+
+    /**
+     * Maximum length of the stamp and prefix written before a message.
+     */
+    const size_t max_line_header_length = 96;
+
+    /**
+     * Append a text record as a line without its newline: the stamp, the
+     * prefix and the message. The timestamp is converted here, not when the
+     * record is submitted.
+     *
+     * @param writer The writer to append to.
+     * @param stamp When and where the record was logged.
+     * @param prefix The prefix, empty for none.
+     * @param text The message.
+     * @param length The length of the message.
+     */
+    void write_line(Writer* writer, const Stamp& stamp, const char* prefix, const char* text, size_t length) {
+      char header[max_line_header_length];
+      int header_length = snprintf(header, sizeof(header), "[%12.6f f%llu t%u] ", to_seconds(stamp.time),
+                                   (unsigned long long)stamp.frame, stamp.thread);
+      write(writer, header, (size_t)header_length);
+
+      if(prefix[0]) {
+        write(writer, "[", 1);
+        write(writer, prefix, strlen(prefix));
+        write(writer, "] ", 2);
+      }
+      write(writer, text, length);
+    }
+
+    /**
+     * Write a record to the console, color included, in a single write.
+     *
+     * @param color The color to log the record with.
+     * @param prefix The prefix, empty for none.
+     * @param text The message.
+     * @param length The length of the message.
+     * @param stamp When and where the record was logged.
+     */
+    void write_record(color color, const char* prefix, const char* text, size_t length, const Stamp& stamp) {
+      if(!console_active.load(std::memory_order_relaxed)) { return; }
+
+      console_mode mode = get_console_mode();
+
+      char line[max_record_length + max_line_header_length + 32];
+      Writer writer = {line, sizeof(line), 0};
+
+      if(mode == console_mode::ansi) {
+        const char* escape = ansi_colors[(int)color];
+        write(&writer, escape, strlen(escape));
+      }
+      write_line(&writer, stamp, prefix, text, length);
+      if(mode == console_mode::ansi) { write(&writer, ansi_reset, sizeof(ansi_reset) - 1); }
+      write(&writer, "\n", 1);
+
+      if(mode == console_mode::win32) { set_color(color); }
+      fwrite(writer.buffer, 1, writer.length, stdout);
+      if(mode == console_mode::win32) { set_color(color::white); }
+    }
+
+    /**
+     * Create a file of a fixed size and map it for writing.
+     *
+     * @param mapped The mapped file to fill in.
+     * @param path The path of the file, overwritten.
+     * @param size The size of the file in bytes.
+     * @return Whether or not the file could be mapped.
+     */
+    bool map_file(MappedFile* mapped, const char* path, size_t size) {
+      *mapped = {};
+
+#ifdef _WIN32
+      mapped->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+                                 FILE_ATTRIBUTE_NORMAL, nullptr);
+      if(mapped->file == INVALID_HANDLE_VALUE) { return false; }
+
+      mapped->mapping = CreateFileMappingA(mapped->file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32),
+                                           (DWORD)size, nullptr);
+      if(mapped->mapping) { mapped->memory = (char*)MapViewOfFile(mapped->mapping, FILE_MAP_WRITE, 0, 0, size); }
+      if(!mapped->memory) {
+        if(mapped->mapping) { CloseHandle(mapped->mapping); }
+        CloseHandle(mapped->file);
+        *mapped = {};
+        return false;
+      }
+#else
+      mapped->file = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+      if(mapped->file == -1) { return false; }
+
+      void* memory = MAP_FAILED;
+      if(ftruncate(mapped->file, (off_t)size) == 0) {
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, mapped->file, 0);
+      }
+      if(memory == MAP_FAILED) {
+        close(mapped->file);
+        *mapped = {};
+        return false;
+      }
+      mapped->memory = (char*)memory;
+#endif
+
+      mapped->size = size;
+      return true;
+    }
+
+    /**
+     * Unmap a file and cut it to its used size.
+     *
+     * @param mapped The mapped file to close.
+     */
+    void unmap_file(MappedFile* mapped) {
+      if(!mapped->memory) { return; }
+
+#ifdef _WIN32
+      UnmapViewOfFile(mapped->memory);
+      CloseHandle(mapped->mapping);
+
+      LARGE_INTEGER used;
+      used.QuadPart = (LONGLONG)mapped->used;
+      SetFilePointerEx(mapped->file, used, nullptr, FILE_BEGIN);
+      SetEndOfFile(mapped->file);
+      CloseHandle(mapped->file);
+#else
+      munmap(mapped->memory, mapped->size);
+      if(ftruncate(mapped->file, (off_t)mapped->used) != 0) {
+        // The tail stays zeros, like after a crash.
+      }
+      close(mapped->file);
+#endif
+
+      *mapped = {};
+    }
+
+    /**
+     * Build the path of a log file or of its index.
+     *
+     * @param path The buffer to build the path in, max_path_length bytes.
+     * @param index Age of the file, 0 for the current one.
+     * @param suffix Appended to the path, empty for the log file.
+     */
+    void make_file_path(char* path, int index, const char* suffix) {
+      if(index == 0) {
+        snprintf(path, max_path_length, "%s%s", file_path, suffix);
+      } else {
+        snprintf(path, max_path_length, "%s.%d%s", file_path, index, suffix);
+      }
+    }
+
+    /**
+     * Rename a file, replacing the destination.
+     */
+    void replace_file(const char* from, const char* to) {
+#ifdef _WIN32
+      MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING);
+#else
+      rename(from, to);
+#endif
+    }
+
+    /**
+     * Close the current log file and its index, shift the older ones by one,
+     * dropping the oldest, and start a new current file.
+     *
+     * @param shift Whether or not to shift the existing files, false to only open.
+     * @return Whether or not the new files could be mapped.
+     */
+    bool rotate_files(bool shift) {
+      unmap_file(&log_file);
+      unmap_file(&index_file);
+
+      char from[max_path_length];
+      char to[max_path_length];
+
+      for(int i = log_file_count - 1; shift && i > 0; i--) {
+        make_file_path(from, i - 1, "");
+        make_file_path(to, i, "");
+        replace_file(from, to);
+
+        make_file_path(from, i - 1, ".idx");
+        make_file_path(to, i, ".idx");
+        replace_file(from, to);
+      }
+
+      make_file_path(to, 0, "");
+      if(!map_file(&log_file, to, log_file_size)) { return false; }
+
+      make_file_path(to, 0, ".idx");
+      if(!map_file(&index_file, to, index_entry_count * sizeof(IndexEntry))) {
+        unmap_file(&log_file);
+        return false;
+      }
+
+      indexed_frame = (uint64_t)-1;
+      return true;
+    }
+
+    /**
+     * Append a text record to the log file, rotating it when it's full. Must
+     * be called by the thread holding the right to drain.
+     *
+     * @param prefix The prefix, empty for none.
+     * @param text The message.
+     * @param length The length of the message.
+     * @param stamp When and where the record was logged.
+     */
+    void write_file_record(const char* prefix, const char* text, size_t length, const Stamp& stamp) {
+      if(!log_file.memory) { return; }
+
+      size_t needed = max_line_header_length + length + 1;
+      if(log_file.used + needed > log_file.size || index_file.used + sizeof(IndexEntry) > index_file.size) {
+        if(!rotate_files(true)) { return; }
+      }
+
+      if(stamp.frame != indexed_frame) {
+        IndexEntry entry = {stamp.frame, log_file.used};
+        memcpy(index_file.memory + index_file.used, &entry, sizeof(entry));
+        index_file.used += sizeof(entry);
+        indexed_frame = stamp.frame;
+      }
+
+      Writer writer = {log_file.memory + log_file.used, log_file.size - log_file.used, 0};
+      write_line(&writer, stamp, prefix, text, length);
+      write(&writer, "\n", 1);
+
+      log_file.used += writer.length;
+    }
+
+    /**
+     * Append a text record to the history ring, overwriting the oldest one.
+     * Must be called by the thread holding the right to drain.
+     *
+     * @param color The color of the record.
+     * @param prefix The prefix, empty for none. Must outlive the record, call sites use literals.
+     * @param text The message.
+     * @param length The length of the message.
+     * @param stamp When and where the record was logged.
+     */
+    void write_history_record(color color, const char* prefix, const char* text, size_t length, const Stamp& stamp) {
+      if(!history_active.load(std::memory_order_relaxed)) { return; }
+
+      HistoryRecord& record = history[history_count % history_capacity];
+      record.sequence       = history_count;
+      record.stamp          = stamp;
+      record.prefix         = prefix;
+      record.text_color     = color;
+      record.length         = length;
+      memcpy(record.text, text, length);
+
+      history_count++;
+    }
+
+    /**
+     * Write a text record to the console, the log file and the history ring.
+     *
+     * @param color The color to log the record with.
+     * @param prefix The prefix, empty for none.
+     * @param text The message.
+     * @param length The length of the message.
+     * @param stamp When and where the record was logged.
+     */
+    void write_text_record(color color, const char* prefix, const char* text, size_t length, const Stamp& stamp) {
+      write_record(color, prefix, text, length, stamp);
+      write_file_record(prefix, text, length, stamp);
+      write_history_record(color, prefix, text, length, stamp);
+    }
+
+    /**
+     * Append a little endian integer to a binary record.
+     *
+     * @param writer The writer to append to.
+     * @param value The value to append.
+     * @param size The size of the value in bytes.
+     */
+    void write_fixed(Writer* writer, uint64_t value, size_t size) {
+      char bytes[8];
+      for(size_t i = 0; i < size; i++) { bytes[i] = (char)(value >> (8 * i)); }
+      write(writer, bytes, size);
+    }
+
+    /**
+     * Write a binary record to the binary file, preceded by the description
+     * of its call site if the stream has none yet. Must be called by the
+     * thread holding the right to drain.
+     *
+     * @param site The call site that logged the record.
+     * @param arg_types The type codes of the encoded arguments.
+     * @param stamp When and where the record was logged.
+     * @param payload The encoded arguments.
+     * @param length The length of the encoded arguments.
+     */
+    void write_binary_record(CallSite* site, const char* arg_types, const Stamp& stamp, const char* payload,
+                             size_t length) {
+      if(!binary_file) { return; }
+
+      if(site->stream != binary_stream) {
+        if(!site->id) { site->id = next_site_id++; }
+        site->stream = binary_stream;
+
+        size_t file_length   = strlen(site->file);
+        size_t format_length = strlen(site->format);
+        size_t types_length  = strlen(arg_types);
+
+        // 'D' id level category line, then the file, format and argument types, each prefixed by its length.
+        char description[1024];
+        Writer writer = {description, sizeof(description), 0};
+        write(&writer, "D", 1);
+        write_fixed(&writer, site->id, 4);
+        write_fixed(&writer, (uint64_t)site->log_level, 1);
+        write_fixed(&writer, (uint64_t)site->log_category, 1);
+        write_fixed(&writer, (uint64_t)site->line, 4);
+        write_fixed(&writer, file_length, 2);
+        write(&writer, site->file, file_length);
+        write_fixed(&writer, format_length, 2);
+        write(&writer, site->format, format_length);
+        write_fixed(&writer, types_length, 1);
+        write(&writer, arg_types, types_length);
+        fwrite(writer.buffer, 1, writer.length, binary_file);
+      }
+
+      // 'E' id timestamp frame thread length, then the encoded arguments.
+      char header[21];
+      Writer writer = {header, sizeof(header), 0};
+      write(&writer, "E", 1);
+      write_fixed(&writer, site->id, 4);
+      write_fixed(&writer, stamp.time, 8);
+      write_fixed(&writer, stamp.frame, 4);
+      write_fixed(&writer, stamp.thread, 2);
+      write_fixed(&writer, length, 2);
+      fwrite(writer.buffer, 1, writer.length, binary_file);
+      fwrite(payload, 1, length, binary_file);
+    }
+
+    /**
+     * Write every record in the ring buffer. Only one thread drains at a time.
+     *
+     * @return Whether or not any record was written.
+     */
+    bool drain() {
+      bool wrote = false;
+
+      for(;;) {
+        size_t position = dequeue_position.load(std::memory_order_relaxed);
+        Slot& slot      = slots[position & slot_mask];
+
+        if(slot.sequence.load(std::memory_order_acquire) != position + 1) { break; }
+
+        Record& record = slot.record;
+        if(record.arg_types) {
+          write_binary_record(record.site, record.arg_types, record.stamp, record.text, record.length);
+        } else {
+          write_text_record(record.site->text_color, record.site->prefix, record.text, record.length, record.stamp);
+        }
+        wrote = true;
+
+        slot.sequence.store(position + slot_mask + 1, std::memory_order_release);
+        dequeue_position.store(position + 1, std::memory_order_release);
+      }
+
+      if(policy == overflow_policy::count) {
+        if(size_t count = unreported_drops.exchange(0, std::memory_order_relaxed)) {
+          char text[64];
+          int length = snprintf(text, sizeof(text), "%zu log records dropped, the log buffer was full.", count);
+          write_text_record(color::yellow, "WARN", text, (size_t)length, make_stamp());
+          wrote = true;
+        }
+      }
+
+      return wrote;
+    }
+
+    /**
+     * Take the right to drain the ring buffer.
+     *
+     * @param spins How many times to retry before giving up, 0 to wait forever.
+     * @return Whether or not the right was taken.
+     */
+    bool lock_drain(size_t spins) {
+      for(size_t i = 0; spins == 0 || i < spins; i++) {
+        bool expected = false;
+        if(draining.compare_exchange_weak(expected, true, std::memory_order_acquire)) { return true; }
+        std::this_thread::yield();
+      }
+
+      return false;
+    }
+
+    void unlock_drain() { draining.store(false, std::memory_order_release); }
+
+    /**
+     * Enter the async path as a producer. stop_async waits for every producer
+     * that entered before it frees the ring buffer.
+     *
+     * @return Whether or not the record goes to the ring buffer, if so leave_async must follow.
+     */
+    bool enter_async() {
+      // Sequentially consistent with stop_async: either it sees the producer, or the producer sees the stop.
+      producers.fetch_add(1);
+      if(async_running.load()) { return true; }
+
+      producers.fetch_sub(1, std::memory_order_release);
+      return false;
+    }
+
+    /**
+     * Leave the async path once the record was published or dropped.
+     */
+    void leave_async() { producers.fetch_sub(1, std::memory_order_release); }
+
+    /**
+     * Claim a slot of the ring buffer for a new record.
+     *
+     * @param claimed_position Set to the position of the claimed slot.
+     * @return The claimed slot, nullptr if the record is dropped. Its sequence
+     * must be set to the position + 1 once the record is written.
+     */
+    Slot* claim_slot(size_t* claimed_position) {
+      size_t position = enqueue_position.load(std::memory_order_relaxed);
+      Slot* slot      = nullptr;
+
+      for(;;) {
+        slot              = &slots[position & slot_mask];
+        size_t sequence   = slot->sequence.load(std::memory_order_acquire);
+        intptr_t distance = (intptr_t)sequence - (intptr_t)position;
+
+        if(distance == 0) {
+          if(enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) { break; }
+        } else if(distance < 0) {
+          // The ring buffer is full.
+          if(policy == overflow_policy::block) {
+            std::this_thread::yield();
+            position = enqueue_position.load(std::memory_order_relaxed);
+            continue;
+          }
+
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          if(policy == overflow_policy::count) { unreported_drops.fetch_add(1, std::memory_order_relaxed); }
+          return nullptr;
+        } else {
+          position = enqueue_position.load(std::memory_order_relaxed);
+        }
+      }
+
+      *claimed_position = position;
+      return slot;
+    }
+
+    /**
+     * Background thread: write records as they come, sleep while idle. The
+     * producers never wake it up, so logging costs them no syscall.
+     */
+    void consume() {
+      // Calibrated here so no caller ever waits for it.
+      calibrate_clock();
+
+      while(consumer_running.load(std::memory_order_acquire)) {
+        lock_drain(0);
+        bool wrote = drain();
+        unlock_drain();
+
+        if(wrote) {
+          fflush(stdout);
+          if(binary_file) { fflush(binary_file); }
+        } else {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+      }
+    }
+
+    /**
+     * Crash handler: write whatever is still buffered from the crashing thread,
+     * then let the default handler run.
+     */
+    void crash_handler(int signal_number) {
+      // The consumer may have crashed mid-write, or still be draining: don't wait for it forever, and only
+      // drain once the ring buffer is ours so no record is written twice.
+      if(slots && lock_drain(100000)) {
+        drain();
+        unlock_drain();
+      }
+      fflush(stdout);
+      if(binary_file) { fflush(binary_file); }
+
+      if(crash_callback) { crash_callback(); }
+
+      signal(signal_number, SIG_DFL);
+      raise(signal_number);
+    }
+
+    void install_crash_handlers() {
+      static bool installed = false;
+      if(installed) { return; }
+      installed = true;
+
+      signal(SIGSEGV, crash_handler);
+      signal(SIGABRT, crash_handler);
+      signal(SIGFPE, crash_handler);
+      signal(SIGILL, crash_handler);
+#ifdef SIGBUS
+      signal(SIGBUS, crash_handler);
+#endif
+#ifdef SIGTRAP
+      signal(SIGTRAP, crash_handler);
+#endif
+      atexit(stop_async);
+    }
+  }  // namespace
+
   /**
-   * Set the color of the console.
+   * Measure the ticks per second of timestamp against the steady clock.
    *
-   * @param color The color to set the console to.
+   * @return The ticks per second.
    */
-  void set_color(color color) {
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    SetConsoleTextAttribute(hConsole, static_cast<int>(color));
+  uint64_t calibrate_clock() {
+    if(uint64_t ticks = ticks_per_second.load(std::memory_order_relaxed)) { return ticks; }
+
+    // Long enough for a precise rate, usually long gone by the first log call.
+    const std::chrono::milliseconds calibration_time(5);
+
+    const ClockBase& base = get_clock_base();
+    std::this_thread::sleep_until(base.time + calibration_time);
+
+    uint64_t ticks                             = timestamp();
+    std::chrono::steady_clock::time_point time = std::chrono::steady_clock::now();
+
+    double seconds = std::chrono::duration<double>(time - base.time).count();
+    uint64_t rate  = (uint64_t)((double)(ticks - base.ticks) / seconds);
+
+    // Threads calibrating at once get close enough rates, keep the first.
+    uint64_t expected = 0;
+    if(ticks_per_second.compare_exchange_strong(expected, rate, std::memory_order_relaxed)) {
+      set_rate_limit(rate_limit_records.load(std::memory_order_relaxed),
+                     rate_limit_window.load(std::memory_order_relaxed));
+    }
+
+    return ticks_per_second.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Set the rate limit of the text warnings and errors of each call site.
+   *
+   * @param records The most records per window, 0 for no limit.
+   * @param window The length of the window in nanoseconds.
+   */
+  void set_rate_limit(uint32_t records, uint64_t window) {
+    rate_limit_records.store(records, std::memory_order_relaxed);
+    rate_limit_window.store(window, std::memory_order_relaxed);
+
+    // Until the clock is calibrated, calibrate_clock converts the window.
+    if(uint64_t ticks = ticks_per_second.load(std::memory_order_relaxed)) {
+      rate_limit_window_ticks.store((uint64_t)(window * 1e-9 * ticks), std::memory_order_relaxed);
+    }
   }
 
   /**
-   * Log a message to the console.
+   * Convert a timestamp to seconds since the logger started.
    *
-   * @param message The message to log.
+   * @param time The timestamp in ticks.
+   * @return The seconds since startup.
    */
-  void log(std::string message) { std::cout << message << std::endl; }
+  double to_seconds(uint64_t time) {
+    return (double)(int64_t)(time - get_clock_base().ticks) / (double)get_ticks_per_second();
+  }
 
   /**
-   * Log a message to the console with a color.
+   * Start the async mode.
    *
-   * @param message The message to log.
-   * @param color The color to log the message with.
+   * @param capacity The amount of records the ring buffer can hold, rounded up to a power of two.
+   * @param overflow What to do when the ring buffer is full.
+   */
+  void start_async(size_t capacity, overflow_policy overflow) {
+    if(async_running.load()) { return; }
+
+    size_t slot_count = 2;
+    while(slot_count < capacity) { slot_count <<= 1; }
+
+    slots = (Slot*)malloc(sizeof(Slot) * slot_count);
+    if(!slots) {
+      SM_ERROR("Failed to allocate the async log buffer, logging stays synchronous.");
+      return;
+    }
+
+    for(size_t i = 0; i < slot_count; i++) { new(&slots[i].sequence) std::atomic<size_t>(i); }
+
+    slot_mask = slot_count - 1;
+    policy    = overflow;
+    enqueue_position.store(0);
+    dequeue_position.store(0);
+
+    install_crash_handlers();
+
+    consumer_running.store(true, std::memory_order_release);
+    async_running.store(true, std::memory_order_release);
+    consumer = std::thread(consume);
+  }
+
+  /**
+   * Stop the async mode, writing every buffered record first. Safe while
+   * other threads keep logging, their records are written synchronously from
+   * then on.
+   */
+  void stop_async() {
+    report_listed(true);
+
+    // New records take the sync path from here on.
+    if(!async_running.exchange(false)) { return; }
+
+    // Wait for the producers already queueing a record, the consumer keeps draining for them.
+    while(producers.load()) { std::this_thread::yield(); }
+
+    consumer_running.store(false, std::memory_order_release);
+    if(consumer.joinable()) { consumer.join(); }
+
+    // Records the consumer didn't get to.
+    lock_drain(0);
+    drain();
+    Slot* ring = slots;
+    slots      = nullptr;
+    unlock_drain();
+    fflush(stdout);
+
+    free(ring);
+  }
+
+  /**
+   * Report every suppressed record, then wait until every record logged so
+   * far was written.
    */
-  void log(std::string message, color color) {
-    set_color(color);
-    printf("%s\n", message.c_str());
-    set_color(color::white);
+  void flush() {
+    report_listed(true);
+
+    if(async_running.load(std::memory_order_acquire)) {
+      size_t target = enqueue_position.load(std::memory_order_acquire);
+      while(dequeue_position.load(std::memory_order_acquire) < target) { std::this_thread::yield(); }
+    }
+
+    fflush(stdout);
+    if(binary_file) { fflush(binary_file); }
   }
 
   /**
-   * Log a message to the console with a prefix.
+   * Get the amount of records dropped because the ring buffer was full.
    *
-   * @param message The message to log.
-   * @param prefix The prefix to log the message with.
-   * @param color The color to log the message with.
+   * @return The amount of dropped records since startup.
    */
-  void log(std::string message, std::string prefix, color color) {
-    set_color(color);
-    printf("[%s] %s\n", prefix.c_str(), message.c_str());
-    set_color(color::white);
+  size_t dropped_count() { return dropped.load(std::memory_order_relaxed); }
+
+  /**
+   * Start the binary mode.
+   *
+   * @param path The path of the binary log file, overwritten.
+   * @return Whether or not the file could be opened.
+   */
+  bool start_binary(const char* path) {
+    stop_binary();
+
+    FILE* file = fopen(path, "wb");
+    if(!file) {
+      SM_ERROR("Failed to open the binary log file '{}'.", path);
+      return false;
+    }
+
+    // Magic and version, then 'C' with the clock base and ticks per second to convert the timestamps.
+    char header[25];
+    Writer writer = {header, sizeof(header), 0};
+    write(&writer, "SMLOG\0\0\2", 8);
+    write(&writer, "C", 1);
+    write_fixed(&writer, get_clock_base().ticks, 8);
+    write_fixed(&writer, get_ticks_per_second(), 8);
+    fwrite(writer.buffer, 1, writer.length, file);
+
+    lock_drain(0);
+    binary_file = file;
+    binary_stream++;
+    unlock_drain();
+
+    binary_active.store(true, std::memory_order_release);
+    return true;
   }
 
   /**
-   * Log a message to the console with a prefix and a argument.
+   * Stop the binary mode, writing every buffered record first.
+   */
+  void stop_binary() {
+    if(!binary_active.exchange(false)) { return; }
+
+    flush();
+
+    lock_drain(0);
+    fclose(binary_file);
+    binary_file = nullptr;
+    unlock_drain();
+  }
+
+  /**
+   * Start the file mode.
    *
-   * @param message The message to log.
-   * @param arg The argument to log the message with.
-   * @param prefix The prefix to log the message with.
-   * @param color The color to log the message with.
+   * @param path The path of the current log file.
+   * @param size The size of each log file in bytes.
+   * @param count The amount of log files kept, the current one included.
+   * @return Whether or not the file could be mapped.
    */
-  template <typename T>
-  void log(std::string message, T arg, std::string prefix, color color) {
-    set_color(color);
-    // If the message has a {} in it, replace it with the argument.
-    // TODO: Make this work with multiple arguments.
-    // TODO: Add more transformations, like {} -> std::to_string(arg), etc.
-    if(message.find("{}") != std::string::npos) { message.replace(message.find("{}"), 2, std::to_string(arg)); }
+  bool start_file(const char* path, size_t size, int count) {
+    stop_file();
 
-    printf("[%s] %s\n", prefix.c_str(), message.c_str());
+    lock_drain(0);
+    snprintf(file_path, sizeof(file_path), "%s", path);
+    log_file_size  = size < 4096 ? 4096 : size;
+    log_file_count = count < 1 ? 1 : count;
+    bool mapped    = rotate_files(true);
+    unlock_drain();
 
-    set_color(color::white);
+    if(!mapped) { SM_ERROR("Failed to map the log file '{}'.", path); }
+    return mapped;
+  }
+
+  /**
+   * Stop the file mode, writing every buffered record first.
+   */
+  void stop_file() {
+    flush();
+
+    lock_drain(0);
+    unmap_file(&log_file);
+    unmap_file(&index_file);
+    unlock_drain();
+  }
+
+  /**
+   * Copy text records from the history ring.
+   *
+   * @param first Sequence of the first record to copy, older records are skipped if already overwritten.
+   * @param records Where to copy the records.
+   * @param max_count The most records to copy.
+   * @return The amount of records copied.
+   */
+  size_t read_history(uint64_t first, HistoryRecord* records, size_t max_count) {
+    lock_drain(0);
+
+    uint64_t oldest = history_count > history_capacity ? history_count - history_capacity : 0;
+    if(first < oldest) { first = oldest; }
+
+    size_t count = 0;
+    for(uint64_t sequence = first; sequence < history_count && count < max_count; sequence++) {
+      records[count++] = history[sequence % history_capacity];
+    }
+
+    unlock_drain();
+    return count;
+  }
+
+  /**
+   * Write every record of the history ring to a file, oldest first.
+   *
+   * @param file The file to write to.
+   */
+  void dump_history(FILE* file) {
+    // Also called while crashing, don't wait forever for a thread that may be dead.
+    bool locked = lock_drain(100000);
+
+    uint64_t oldest = history_count > history_capacity ? history_count - history_capacity : 0;
+    for(uint64_t sequence = oldest; sequence < history_count; sequence++) {
+      const HistoryRecord& record = history[sequence % history_capacity];
+
+      char line[max_record_length + max_line_header_length + 1];
+      Writer writer = {line, sizeof(line), 0};
+      write_line(&writer, record.stamp, record.prefix, record.text, record.length);
+      write(&writer, "\n", 1);
+      fwrite(writer.buffer, 1, writer.length, file);
+    }
+
+    if(locked) { unlock_drain(); }
+  }
+
+  /**
+   * Call a function when the process crashes.
+   *
+   * @param callback The function to call, nullptr for none.
+   */
+  void set_crash_callback(void (*callback)()) {
+    crash_callback = callback;
+    install_crash_handlers();
+  }
+
+  /**
+   * Advance the frame number stamped on records, and report the records the
+   * call sites dropped in the rate limit windows that are over.
+   */
+  void end_frame() {
+    frame_number.fetch_add(1, std::memory_order_relaxed);
+    report_listed(false);
+  }
+
+  /**
+   * Report the records a call site dropped to its rate limit, as one record.
+   *
+   * @param site The call site.
+   * @param count The amount of dropped records.
+   */
+  void report_suppressed(CallSite* site, uint32_t count) {
+    char text[max_record_length];
+    Writer writer = {text, sizeof(text), 0};
+
+    format_to(&writer, "Suppressed {} more records from {}:{}.", count, site->file, site->line);
+    submit(site, writer.buffer, writer.length);
+  }
+
+  /**
+   * Add a call site to the list of sites with unreported suppressed records,
+   * reported by end_frame once their window is over, or by flush.
+   *
+   * @param site The call site.
+   */
+  void list_suppressed(CallSite* site) {
+    if(!site->listed.exchange(true)) { push_listed(site); }
+  }
+
+  /**
+   * Write a text record, or queue it for the background thread in async mode.
+   *
+   * @param site The call site that logged the record.
+   * @param text The message.
+   * @param length The length of the message.
+   */
+  void submit(CallSite* site, const char* text, size_t length) {
+    if(length > max_record_length) { length = max_record_length; }
+
+    Stamp stamp = make_stamp();
+
+    if(!enter_async()) {
+      lock_drain(0);
+      write_text_record(site->text_color, site->prefix, text, length, stamp);
+      unlock_drain();
+      return;
+    }
+
+    size_t position;
+    if(Slot* slot = claim_slot(&position)) {
+      Record& record   = slot->record;
+      record.site      = site;
+      record.arg_types = nullptr;
+      record.stamp     = stamp;
+      record.length    = length;
+      memcpy(record.text, text, length);
+
+      slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    leave_async();
+  }
+
+  /**
+   * Write a binary record, or queue it for the background thread in async mode.
+   *
+   * @param site The call site that logged the record.
+   * @param arg_types The type codes of the arguments, see arg_code.
+   * @param payload The encoded arguments.
+   * @param length The length of the encoded arguments.
+   */
+  void submit_binary(CallSite* site, const char* arg_types, const char* payload, size_t length) {
+    if(length > max_record_length) { length = max_record_length; }
+
+    Stamp stamp = make_stamp();
+
+    if(!enter_async()) {
+      lock_drain(0);
+      write_binary_record(site, arg_types, stamp, payload, length);
+      unlock_drain();
+      return;
+    }
+
+    size_t position;
+    if(Slot* slot = claim_slot(&position)) {
+      Record& record   = slot->record;
+      record.site      = site;
+      record.arg_types = arg_types;
+      record.stamp     = stamp;
+      record.length    = length;
+      memcpy(record.text, payload, length);
+
+      slot->sequence.store(position + 1, std::memory_order_release);
+    }
+
+    leave_async();
+  }
+
+  /**
+   * Set the color of the console, nothing if the output isn't a terminal.
+   *
+   * @param color The color to set the console to.
+   */
+  void set_color(color color) {
+    switch(get_console_mode()) {
+      case console_mode::plain: break;
+      case console_mode::ansi: fputs(ansi_colors[(int)color], stdout); break;
+      case console_mode::win32: {
+#ifdef _WIN32
+        // The attributes apply to what was already written, flush it first.
+        fflush(stdout);
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        SetConsoleTextAttribute(hConsole, static_cast<int>(color));
+#endif
+        break;
+      }
+    }
   }
-}  // namespace logger
\ No newline at end of file
+}  // namespace logger
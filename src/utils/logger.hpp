@@ -2,11 +2,48 @@
 #ifndef _LOGGER_HPP
 #define _LOGGER_HPP
 
+#ifdef _WIN32
 #include <Windows.h>
+#endif
+#ifndef SM_LOG_RDTSC
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SM_LOG_RDTSC 1
+#else
+#define SM_LOG_RDTSC 0
+#endif
+#endif
+#if SM_LOG_RDTSC
+#ifdef _WIN32
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+#endif
+#include <stddef.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
 
-#include <iostream>
+#include <atomic>
+#include <chrono>
 #include <string>
+#include <string_view>
+#include <type_traits>
+
+// Log levels, usable by the preprocessor.
+#define SM_LOG_LEVEL_TRACE 0
+#define SM_LOG_LEVEL_INFO  1
+#define SM_LOG_LEVEL_WARN  2
+#define SM_LOG_LEVEL_ERROR 3
+#define SM_LOG_LEVEL_OFF   4
+
+// Minimum level compiled in, the macros of lower levels expand to nothing and
+// don't evaluate their arguments. Build with e.g. -DSM_MIN_LOG_LEVEL=SM_LOG_LEVEL_WARN.
+#ifndef SM_MIN_LOG_LEVEL
+#define SM_MIN_LOG_LEVEL SM_LOG_LEVEL_TRACE
+#endif
 
 namespace logger {
   /**
@@ -32,6 +69,451 @@ namespace logger {
     white
   };
 
+  /**
+   * Severity of a log record.
+   */
+  enum class level
+  {
+    trace = SM_LOG_LEVEL_TRACE,
+    info  = SM_LOG_LEVEL_INFO,
+    warn  = SM_LOG_LEVEL_WARN,
+    error = SM_LOG_LEVEL_ERROR,
+    count
+  };
+
+  /**
+   * Subsystem a log record comes from, each one can be toggled at runtime.
+   */
+  enum class category
+  {
+    general,
+    renderer,
+    window,
+    allocator,
+    game,
+    io,
+    count
+  };
+
+  /**
+   * Names of the levels and categories, indexed by their value.
+   */
+  inline constexpr const char* level_names[]    = {"TRACE", "INFO", "WARN", "ERROR"};
+  inline constexpr const char* category_names[] = {"general", "renderer", "window", "allocator", "game", "io"};
+
+  /**
+   * Per level bitmask of the enabled categories, bit n is category n. Every
+   * category is enabled by default.
+   */
+  inline std::atomic<uint32_t> enabled_categories[(int)level::count] = {~0u, ~0u, ~0u, ~0u};
+
+  /**
+   * Check if records of a level and category are logged, a single load and
+   * branch taken before any formatting.
+   *
+   * @param level The level of the record.
+   * @param category The category of the record.
+   * @return Whether or not the record is logged.
+   */
+  inline bool is_enabled(level level, category category) {
+    return enabled_categories[(int)level].load(std::memory_order_relaxed) & (1u << (int)category);
+  }
+
+  /**
+   * Log the records of a category from a minimum level up.
+   *
+   * @param category The category to set.
+   * @param min_level The lowest level logged, level::count to silence the category.
+   */
+  inline void set_level(category category, level min_level) {
+    uint32_t bit = 1u << (int)category;
+
+    for(int i = 0; i < (int)level::count; i++) {
+      if(i >= (int)min_level) {
+        enabled_categories[i].fetch_or(bit, std::memory_order_relaxed);
+      } else {
+        enabled_categories[i].fetch_and(~bit, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * Static description of an SM_* call site, one per macro expansion.
+   */
+  struct CallSite {
+    const char* format;     // the format string
+    const char* prefix;     // the prefix to log the message with
+    color text_color;       // the color to log the message with
+    level log_level;        // the level of the records
+    category log_category;  // the category of the records
+    const char* file;       // the source file of the call site
+    int line;               // the source line of the call site
+    uint32_t id     = 0;    // id of the call site in binary streams, 0 until it was first written to one
+    uint32_t stream = 0;    // the binary stream the call site was last described in
+
+    std::atomic<uint64_t> window_start = {0};      // timestamp of the current rate limit window
+    std::atomic<uint32_t> window_count = {0};      // records logged in the current rate limit window
+    std::atomic<uint32_t> suppressed   = {0};      // records dropped by the rate limit, not reported yet
+    std::atomic<bool> listed           = {false};  // whether or not the site is in the list of unreported sites
+    CallSite* next_listed              = nullptr;  // next site of the list of unreported sites
+  };
+
+  /**
+   * Whether or not records go to the binary stream, see start_binary.
+   */
+  inline std::atomic<bool> binary_active{false};
+
+  /**
+   * Whether or not text records are written to the console. The file sink
+   * and the history ring still get them when it's off.
+   */
+  inline std::atomic<bool> console_active{true};
+
+  /**
+   * Whether or not text records are kept in the history ring, see
+   * read_history. The console and file sinks still get them when it's off.
+   */
+  inline std::atomic<bool> history_active{true};
+
+#if SM_LOG_RDTSC
+  /**
+   * Check whether or not the time stamp counter is invariant: ticking at a
+   * constant rate through frequency changes and sleep states, so its ticks
+   * can be converted to time.
+   *
+   * @return Whether or not the time stamp counter is invariant.
+   */
+  inline bool has_invariant_tsc() {
+#ifdef _WIN32
+    int registers[4];
+    __cpuid(registers, 0x80000000);
+    if((unsigned int)registers[0] < 0x80000007) { return false; }
+
+    __cpuid(registers, 0x80000007);
+    return registers[3] & (1 << 8);
+#else
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8));
+#endif
+  }
+#endif
+
+  /**
+   * Get the timestamp of a record, in raw ticks of the cheapest monotonic
+   * counter: the time stamp counter on x86 when it's invariant, the
+   * performance counter on Windows and CLOCK_MONOTONIC_RAW elsewhere.
+   * Convert with to_seconds when formatting only.
+   *
+   * @return The timestamp in ticks.
+   */
+  inline uint64_t timestamp() {
+#if SM_LOG_RDTSC
+    static const bool invariant_tsc = has_invariant_tsc();
+    if(invariant_tsc) { return __rdtsc(); }
+#endif
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+#else
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+#endif
+  }
+
+  /**
+   * Ticks of timestamp per second, 0 until calibrated.
+   */
+  inline std::atomic<uint64_t> ticks_per_second{0};
+
+  /**
+   * Measure the ticks per second of timestamp against the steady clock,
+   * once, sleeping until a few milliseconds passed since startup. Done by the
+   * consumer thread when the async mode starts.
+   *
+   * @return The ticks per second.
+   */
+  uint64_t calibrate_clock();
+
+  /**
+   * Get the ticks per second of timestamp, calibrating the first time.
+   *
+   * @return The ticks per second.
+   */
+  inline uint64_t get_ticks_per_second() {
+    uint64_t ticks = ticks_per_second.load(std::memory_order_relaxed);
+    return ticks ? ticks : calibrate_clock();
+  }
+
+  /**
+   * Convert a timestamp to seconds since the logger started.
+   *
+   * @param time The timestamp in ticks.
+   * @return The seconds since startup.
+   */
+  double to_seconds(uint64_t time);
+
+  /**
+   * Counter handing out thread ids.
+   */
+  inline std::atomic<uint32_t> next_thread_id{0};
+
+  /**
+   * Get the id of the calling thread, small integers in the order threads
+   * first log.
+   *
+   * @return The thread id.
+   */
+  inline uint32_t thread_id() {
+    thread_local uint32_t id = next_thread_id.fetch_add(1, std::memory_order_relaxed);
+    return id;
+  }
+
+  /**
+   * When and where a record was logged, taken when it's submitted.
+   */
+  struct Stamp {
+    uint64_t time;    // timestamp in ticks
+    uint64_t frame;   // frame number
+    uint32_t thread;  // thread id
+  };
+
+  /**
+   * Rate limit of the text warnings and errors of each call site, so one
+   * repeated every frame can't flood the log: at most rate_limit_records
+   * records per rate_limit_window nanoseconds, 0 records for no limit.
+   * Traces, info and binary records are never limited. Change the window
+   * with set_rate_limit only, it's converted to ticks once.
+   */
+  inline std::atomic<uint32_t> rate_limit_records{10};
+  inline std::atomic<uint64_t> rate_limit_window{1000000000};
+
+  /**
+   * The rate limit window in ticks of timestamp, 0 until the clock is
+   * calibrated, records aren't limited until then.
+   */
+  inline std::atomic<uint64_t> rate_limit_window_ticks{0};
+
+  /**
+   * Set the rate limit of the text warnings and errors of each call site.
+   *
+   * @param records The most records per window, 0 for no limit.
+   * @param window The length of the window in nanoseconds.
+   */
+  void set_rate_limit(uint32_t records, uint64_t window);
+
+  /**
+   * Get the rate limit window in ticks of timestamp.
+   *
+   * @return The window in ticks, 0 until the clock is calibrated.
+   */
+  inline uint64_t get_rate_limit_window() { return rate_limit_window_ticks.load(std::memory_order_relaxed); }
+
+  /**
+   * Report the records a call site dropped to its rate limit, as one record.
+   *
+   * @param site The call site.
+   * @param count The amount of dropped records.
+   */
+  void report_suppressed(CallSite* site, uint32_t count);
+
+  /**
+   * Add a call site to the list of sites with unreported suppressed records,
+   * reported by end_frame once their window is over, or by flush.
+   *
+   * @param site The call site.
+   */
+  void list_suppressed(CallSite* site);
+
+  /**
+   * Check the rate limit of a call site, lock-free. The first record of a
+   * new window reports how many records the previous windows dropped.
+   *
+   * @param site The call site.
+   * @return Whether or not the record may be logged.
+   */
+  inline bool check_rate_limit(CallSite* site) {
+    uint32_t limit = rate_limit_records.load(std::memory_order_relaxed);
+    if(!limit || site->log_level < level::warn) { return true; }
+
+    uint64_t window = get_rate_limit_window();
+    if(!window) { return true; }
+
+    uint64_t now   = timestamp();
+    uint64_t start = site->window_start.load(std::memory_order_relaxed);
+
+    if(now - start >= window &&
+       site->window_start.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+      // Only one thread wins the new window.
+      site->window_count.store(0, std::memory_order_relaxed);
+      if(uint32_t count = site->suppressed.exchange(0, std::memory_order_relaxed)) { report_suppressed(site, count); }
+    }
+
+    // Once over the limit, skip the increment so repeats don't bounce the counter between cores.
+    if(site->window_count.load(std::memory_order_relaxed) < limit &&
+       site->window_count.fetch_add(1, std::memory_order_relaxed) < limit) {
+      return true;
+    }
+
+    // The first unreported record lists the site, so a burst that stops is still reported.
+    if(site->suppressed.fetch_add(1, std::memory_order_relaxed) == 0) { list_suppressed(site); }
+    return false;
+  }
+
+  /**
+   * What the async logger does when its ring buffer is full.
+   */
+  enum class overflow_policy
+  {
+    drop,   // discard the record
+    block,  // wait until the background thread makes room
+    count   // discard the record and log how many were discarded once there is room
+  };
+
+  /**
+   * Maximum length of a log message in bytes, longer messages are cut.
+   */
+  inline constexpr size_t max_record_length = 256;
+
+  /**
+   * Start the async mode. Callers only copy their record into a lock-free ring
+   * buffer, a background thread writes it to the console. Buffered records
+   * are flushed by stop_async, at exit and when the process crashes.
+   *
+   * @param capacity The amount of records the ring buffer can hold, rounded up to a power of two.
+   * @param overflow What to do when the ring buffer is full.
+   */
+  void start_async(size_t capacity = 4096, overflow_policy overflow = overflow_policy::count);
+
+  /**
+   * Stop the async mode, writing every buffered record first.
+   */
+  void stop_async();
+
+  /**
+   * Report every suppressed record, then wait until every record logged so
+   * far was written.
+   */
+  void flush();
+
+  /**
+   * Get the amount of records dropped because the ring buffer was full.
+   *
+   * @return The amount of dropped records since startup.
+   */
+  size_t dropped_count();
+
+  /**
+   * Start the binary mode. Records are no longer formatted by the caller:
+   * only the call site id, a timestamp and the raw argument bytes are written
+   * to the file, to be turned back into text by tools/log_decode. Each call
+   * site is described in the stream the first time it logs to it. Warnings
+   * and errors are still written to the console as well.
+   *
+   * @param path The path of the binary log file, overwritten.
+   * @return Whether or not the file could be opened.
+   */
+  bool start_binary(const char* path);
+
+  /**
+   * Stop the binary mode, writing every buffered record first.
+   */
+  void stop_binary();
+
+  /**
+   * Start the file mode. Text records are also appended to a memory-mapped,
+   * preallocated file, so appending is a memcpy and not a syscall, and a
+   * crash loses at most the record being written. Files rotate by size:
+   * path is the current file, path.1 the previous one and so on.
+   *
+   * Each file comes with path.idx, an index of 16 byte entries {frame, offset}
+   * giving the offset of the first record of every frame. After a crash the
+   * rest of a file and of its index are zeros.
+   *
+   * @param path The path of the current log file.
+   * @param size The size of each log file in bytes.
+   * @param count The amount of log files kept, the current one included.
+   * @return Whether or not the file could be mapped.
+   */
+  bool start_file(const char* path, size_t size = 16 * 1024 * 1024, int count = 4);
+
+  /**
+   * Stop the file mode, writing every buffered record first and cutting the
+   * files to their used size.
+   */
+  void stop_file();
+
+  /**
+   * Amount of text records kept in memory by the history ring.
+   */
+  inline constexpr size_t history_capacity = 4096;
+
+  /**
+   * A text record kept in the history ring.
+   */
+  struct HistoryRecord {
+    uint64_t sequence;             // position of the record in the history, counting from 0 at startup
+    Stamp stamp;                   // when and where the record was logged
+    const char* prefix;            // the prefix, empty for none
+    color text_color;              // the color of the record
+    size_t length;                 // length of the text in bytes
+    char text[max_record_length];  // the message, not null terminated
+  };
+
+  /**
+   * Copy text records from the history ring, the last history_capacity
+   * records written are kept in a static array. Meant for an in-game console
+   * that keeps a cursor and copies only what's new every frame.
+   *
+   * @param first Sequence of the first record to copy, older records are skipped if already overwritten.
+   * @param records Where to copy the records.
+   * @param max_count The most records to copy.
+   * @return The amount of records copied.
+   */
+  size_t read_history(uint64_t first, HistoryRecord* records, size_t max_count);
+
+  /**
+   * Write every record of the history ring to a file, oldest first.
+   *
+   * @param file The file to write to.
+   */
+  void dump_history(FILE* file);
+
+  /**
+   * Call a function when the process crashes, after the buffered records
+   * were written and before the default handler runs.
+   *
+   * @param callback The function to call, nullptr for none.
+   */
+  void set_crash_callback(void (*callback)());
+
+  /**
+   * Advance the frame number stamped on records, and report the records the
+   * call sites dropped in the rate limit windows that are over. Called once
+   * per frame from the game loop.
+   */
+  void end_frame();
+
+  /**
+   * Write a text record, or queue it for the background thread in async mode.
+   *
+   * @param site The call site that logged the record.
+   * @param text The message.
+   * @param length The length of the message.
+   */
+  void submit(CallSite* site, const char* text, size_t length);
+
+  /**
+   * Write a binary record, or queue it for the background thread in async mode.
+   *
+   * @param site The call site that logged the record.
+   * @param arg_types The type codes of the arguments, see arg_code.
+   * @param payload The encoded arguments.
+   * @param length The length of the encoded arguments.
+   */
+  void submit_binary(CallSite* site, const char* arg_types, const char* payload, size_t length);
+
   /**
    * Set the color of the console.
    *
@@ -40,57 +522,368 @@ namespace logger {
   void set_color(color color);
 
   /**
-   * Log a message to the console.
+   * Value returned by count_placeholders for a malformed format string.
+   */
+  inline constexpr size_t invalid_format = (size_t)-1;
+
+  /**
+   * Count the {} placeholders of a format string at compile time. {{ and }}
+   * are escaped braces, any other brace makes the format invalid.
+   *
+   * @param format The format string.
+   * @return The amount of placeholders, or invalid_format.
+   */
+  constexpr size_t count_placeholders(const char* format) {
+    size_t count = 0;
+
+    for(size_t i = 0; format[i]; i++) {
+      if(format[i] == '{') {
+        if(format[i + 1] != '{' && format[i + 1] != '}') { return invalid_format; }
+        if(format[i + 1] == '}') { count++; }
+        i++;
+      } else if(format[i] == '}') {
+        if(format[i + 1] != '}') { return invalid_format; }
+        i++;
+      }
+    }
+
+    return count;
+  }
+
+  /**
+   * Count the arguments of a log call in an unevaluated context, used by the
+   * SM_* macros to check them against the format string.
+   */
+  template <typename... Args>
+  constexpr std::integral_constant<size_t, sizeof...(Args)> count_args(const Args&...) {
+    return {};
+  }
+
+  /**
+   * Fixed-size output buffer, writes past the capacity are cut.
+   */
+  struct Writer {
+    char* buffer;     // the output
+    size_t capacity;  // in bytes
+    size_t length;    // in bytes
+  };
+
+  /**
+   * Append text to a writer.
+   *
+   * @param writer The writer to append to.
+   * @param text The text to append.
+   * @param length The length of the text.
+   */
+  inline void write(Writer* writer, const char* text, size_t length) {
+    size_t room = writer->capacity - writer->length;
+    if(length > room) { length = room; }
+
+    memcpy(writer->buffer + writer->length, text, length);
+    writer->length += length;
+  }
+
+  /**
+   * Append an unsigned integer to a writer, without going through printf.
    *
-   * @param message The message to log.
+   * @param writer The writer to append to.
+   * @param value The value to append.
+   * @param negative Whether to prepend a minus sign.
    */
-  void log(std::string message);
+  inline void write_integer(Writer* writer, unsigned long long value, bool negative) {
+    char digits[24];
+    char* end   = digits + sizeof(digits);
+    char* start = end;
+
+    do {
+      *--start = (char)('0' + value % 10);
+      value /= 10;
+    } while(value);
+
+    if(negative) { *--start = '-'; }
+
+    write(writer, start, (size_t)(end - start));
+  }
+
+  /**
+   * Append a log argument to a writer.
+   *
+   * @param writer The writer to append to.
+   * @param value The argument to append.
+   */
+  template <typename T>
+  void write_arg(Writer* writer, const T& value) {
+    using Type = std::decay_t<T>;
+
+    if constexpr(std::is_same_v<Type, bool>) {
+      write(writer, value ? "true" : "false", value ? 4 : 5);
+    } else if constexpr(std::is_same_v<Type, char>) {
+      write(writer, &value, 1);
+    } else if constexpr(std::is_integral_v<Type>) {
+      if constexpr(std::is_signed_v<Type>) {
+        // Negate in unsigned arithmetic so the minimum value doesn't overflow.
+        unsigned long long magnitude = value < 0 ? 0ull - (unsigned long long)value : (unsigned long long)value;
+        write_integer(writer, magnitude, value < 0);
+      } else {
+        write_integer(writer, (unsigned long long)value, false);
+      }
+    } else if constexpr(std::is_floating_point_v<Type>) {
+      char number[32];
+      int length = snprintf(number, sizeof(number), "%g", (double)value);
+      write(writer, number, (size_t)length);
+    } else if constexpr(std::is_enum_v<Type>) {
+      write_arg(writer, (std::underlying_type_t<Type>)value);
+    } else if constexpr(std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>) {
+      // Char buffers are never null, and may not be terminated.
+      write(writer, value, strnlen(value, std::extent_v<T>));
+    } else if constexpr(std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>) {
+      const char* text = value ? value : "(null)";
+      write(writer, text, strlen(text));
+    } else if constexpr(std::is_convertible_v<const T&, std::string_view>) {
+      std::string_view text = value;
+      write(writer, text.data(), text.size());
+    } else if constexpr(std::is_pointer_v<Type>) {
+      char number[32];
+      int length = snprintf(number, sizeof(number), "%p", (const void*)value);
+      write(writer, number, (size_t)length);
+    } else {
+      static_assert(!sizeof(T), "Unsupported log argument type.");
+    }
+  }
+
+  /**
+   * Append format up to its next placeholder, unescaping {{ and }}.
+   *
+   * @param writer The writer to append to.
+   * @param format The format string, advanced past the placeholder.
+   * @return Whether or not a placeholder was found.
+   */
+  inline bool write_until_placeholder(Writer* writer, const char** format) {
+    const char* text = *format;
+
+    while(*text) {
+      if((text[0] == '{' && text[1] == '{') || (text[0] == '}' && text[1] == '}')) {
+        write(writer, text, 1);
+        text += 2;
+      } else if(text[0] == '{' && text[1] == '}') {
+        *format = text + 2;
+        return true;
+      } else {
+        const char* start = text;
+        while(*text && *text != '{' && *text != '}') { text++; }
+        write(writer, start, (size_t)(text - start));
+      }
+    }
+
+    *format = text;
+    return false;
+  }
+
+  /**
+   * Format a message into a fixed-size buffer, without allocating.
+   *
+   * @param writer The writer to format into.
+   * @param format The format string, one {} per argument.
+   * @param args The arguments.
+   */
+  template <typename... Args>
+  void format_to(Writer* writer, const char* format, const Args&... args) {
+    // Expand the arguments in order, each one after the text leading to its placeholder.
+    ((write_until_placeholder(writer, &format), write_arg(writer, args)), ...);
+    write_until_placeholder(writer, &format);
+  }
 
   /**
-   * Log a message to the console with a color.
+   * Get the type code of a log argument in the binary stream.
    *
-   * @param message The message to log.
-   * @param color The color to log the message with.
+   * b bool, c char, i signed integer, u unsigned integer, f floating point,
+   * s string, p pointer.
    */
-  void log(std::string message, color color);
+  template <typename T>
+  constexpr char arg_code() {
+    using Type = std::decay_t<T>;
+
+    if constexpr(std::is_same_v<Type, bool>) {
+      return 'b';
+    } else if constexpr(std::is_same_v<Type, char>) {
+      return 'c';
+    } else if constexpr(std::is_integral_v<Type>) {
+      return std::is_signed_v<Type> ? 'i' : 'u';
+    } else if constexpr(std::is_floating_point_v<Type>) {
+      return 'f';
+    } else if constexpr(std::is_enum_v<Type>) {
+      return arg_code<std::underlying_type_t<Type>>();
+    } else if constexpr(std::is_same_v<Type, const char*> || std::is_same_v<Type, char*> ||
+                        std::is_convertible_v<const T&, std::string_view>) {
+      return 's';
+    } else if constexpr(std::is_pointer_v<Type>) {
+      return 'p';
+    } else {
+      static_assert(!sizeof(T), "Unsupported log argument type.");
+    }
+  }
 
   /**
-   * Log a message to the console with a prefix.
+   * Type codes of the arguments of a log call, null terminated.
+   */
+  template <typename... Args>
+  inline constexpr char arg_codes[] = {arg_code<Args>()..., '\0'};
+
+  /**
+   * Append an unsigned LEB128 varint to a writer.
    *
-   * @param message The message to log.
-   * @param prefix The prefix to log the message with.
-   * @param color The color to log the message with.
+   * @param writer The writer to append to.
+   * @param value The value to append.
    */
-  void log(std::string message, std::string prefix, color color = color::white);
+  inline void write_varint(Writer* writer, unsigned long long value) {
+    char bytes[10];
+    size_t length = 0;
+
+    while(value >= 0x80) {
+      bytes[length++] = (char)(value | 0x80);
+      value >>= 7;
+    }
+    bytes[length++] = (char)value;
+
+    write(writer, bytes, length);
+  }
 
   /**
-   * Log a message to the console with a prefix and a argument.
+   * Append the raw bytes of a log argument to a writer, the binary
+   * counterpart of write_arg.
    *
-   * @param message The message to log.
-   * @param arg The argument to log the message with.
-   * @param prefix The prefix to log the message with.
-   * @param color The color to log the message with.
+   * @param writer The writer to append to.
+   * @param value The argument to append.
    */
   template <typename T>
-  void log(std::string message, T arg, std::string prefix = "LOG", color color = color::white);
+  void encode_arg(Writer* writer, const T& value) {
+    using Type = std::decay_t<T>;
+
+    if constexpr(std::is_same_v<Type, bool> || std::is_same_v<Type, char>) {
+      char byte = (char)value;
+      write(writer, &byte, 1);
+    } else if constexpr(std::is_integral_v<Type>) {
+      if constexpr(std::is_signed_v<Type>) {
+        // Zigzag, so small negative values stay small.
+        long long number = (long long)value;
+        write_varint(writer, ((unsigned long long)number << 1) ^ (unsigned long long)(number >> 63));
+      } else {
+        write_varint(writer, (unsigned long long)value);
+      }
+    } else if constexpr(std::is_floating_point_v<Type>) {
+      double number = (double)value;
+      write(writer, (const char*)&number, sizeof(number));
+    } else if constexpr(std::is_enum_v<Type>) {
+      encode_arg(writer, (std::underlying_type_t<Type>)value);
+    } else if constexpr(std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>) {
+      encode_arg(writer, std::string_view(value, strnlen(value, std::extent_v<T>)));
+    } else if constexpr(std::is_same_v<Type, const char*> || std::is_same_v<Type, char*>) {
+      encode_arg(writer, std::string_view(value ? value : "(null)"));
+    } else if constexpr(std::is_convertible_v<const T&, std::string_view>) {
+      std::string_view text = value;
+      write_varint(writer, text.size());
+      write(writer, text.data(), text.size());
+    } else if constexpr(std::is_pointer_v<Type>) {
+      write_varint(writer, (unsigned long long)(uintptr_t)value);
+    }
+  }
+
+  /**
+   * Log a message. The message is formatted on the stack, logging never
+   * allocates. In binary mode the arguments are only encoded, formatting
+   * happens offline. Text records are rate limited per call site.
+   *
+   * @param site The call site that logs the message.
+   * @param format The format string, one {} per argument.
+   * @param args The arguments.
+   */
+  template <typename... Args>
+  void log(CallSite* site, const char* format, const Args&... args) {
+    if(binary_active.load(std::memory_order_relaxed)) {
+      if constexpr(sizeof...(Args) == 0) {
+        submit_binary(site, arg_codes<>, "", 0);
+      } else {
+        char payload[max_record_length];
+        Writer writer = {payload, sizeof(payload), 0};
+
+        (encode_arg(&writer, args), ...);
+        submit_binary(site, arg_codes<Args...>, writer.buffer, writer.length);
+      }
+
+      if(site->log_level < level::warn) { return; }
+    }
+
+    if(!check_rate_limit(site)) { return; }
+
+    char text[max_record_length];
+    Writer writer = {text, sizeof(text), 0};
+
+    format_to(&writer, format, args...);
+    submit(site, writer.buffer, writer.length);
+  }
 }  // namespace logger
 
 #ifdef _WIN32
 #define DEBUG_BREAK() __debugbreak()
-#elif __linux__
+#elif defined(__clang__)
 #define DEBUG_BREAK() __builtin_debugtrap()
 #else
 #define DEBUG_BREAK() __builtin_trap()
 #endif
 
-#define SM_TRACE(...) logger::log(__VA_ARGS__, "TRACE", logger::color::light_gray)
-#define SM_INFO(...)  logger::log(__VA_ARGS__, "INFO", logger::color::light_green)
-#define SM_WARN(...)  logger::log(__VA_ARGS__, "WARN", logger::color::yellow)
-#define SM_ERROR(...) logger::log(__VA_ARGS__, "ERROR", logger::color::red)
+// First argument of a log macro, the format string.
+#define SM_LOG_FORMAT(...)                SM_LOG_FORMAT_HELPER(__VA_ARGS__, 0)
+#define SM_LOG_FORMAT_HELPER(format, ...) format
+
+// Log through the formatter if the level and category are enabled at runtime,
+// describing the call site once in a static, and checking at compile time
+// that the format string is a literal with exactly one {} per argument.
+#define SM_LOG(level, log_category, prefix, color, ...)                                               \
+  do {                                                                                                \
+    static_assert(logger::count_placeholders(SM_LOG_FORMAT(__VA_ARGS__)) ==                           \
+                      decltype(logger::count_args(__VA_ARGS__))::value - 1,                           \
+                  "Log format string must be a literal with one {} per argument.");                   \
+    static logger::CallSite sm_log_site = {SM_LOG_FORMAT(__VA_ARGS__), prefix, color, level,          \
+                                           logger::category::log_category, __FILE__, __LINE__};       \
+    if(logger::is_enabled(level, logger::category::log_category)) {                                   \
+      logger::log(&sm_log_site, __VA_ARGS__);                                                         \
+    }                                                                                                 \
+  } while(0)
+
+#if SM_MIN_LOG_LEVEL <= SM_LOG_LEVEL_TRACE
+#define SM_CTRACE(category, ...) SM_LOG(logger::level::trace, category, "TRACE", logger::color::light_gray, __VA_ARGS__)
+#else
+#define SM_CTRACE(category, ...) ((void)0)
+#endif
+
+#if SM_MIN_LOG_LEVEL <= SM_LOG_LEVEL_INFO
+#define SM_CINFO(category, ...) SM_LOG(logger::level::info, category, "INFO", logger::color::light_green, __VA_ARGS__)
+#else
+#define SM_CINFO(category, ...) ((void)0)
+#endif
+
+#if SM_MIN_LOG_LEVEL <= SM_LOG_LEVEL_WARN
+#define SM_CWARN(category, ...) SM_LOG(logger::level::warn, category, "WARN", logger::color::yellow, __VA_ARGS__)
+#else
+#define SM_CWARN(category, ...) ((void)0)
+#endif
+
+#if SM_MIN_LOG_LEVEL <= SM_LOG_LEVEL_ERROR
+#define SM_CERROR(category, ...) SM_LOG(logger::level::error, category, "ERROR", logger::color::red, __VA_ARGS__)
+#else
+#define SM_CERROR(category, ...) ((void)0)
+#endif
+
+// Log to the general category.
+#define SM_TRACE(...) SM_CTRACE(general, __VA_ARGS__)
+#define SM_INFO(...)  SM_CINFO(general, __VA_ARGS__)
+#define SM_WARN(...)  SM_CWARN(general, __VA_ARGS__)
+#define SM_ERROR(...) SM_CERROR(general, __VA_ARGS__)
 
 #define SM_ASSERT(condition, ...) \
   if(!(condition)) {              \
     SM_ERROR(__VA_ARGS__);        \
+    logger::flush();              \
     DEBUG_BREAK();                \
   }
 
@@ -0,0 +1,181 @@
+#pragma once
+#ifndef _POOL_ALLOCATOR_H
+#define _POOL_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <new>
+#include <utility>
+
+#include "allocator_stats.hpp"
+#include "bump_allocator.hpp"
+#include "logger.hpp"
+
+namespace pool_allocator {
+  /**
+   * Struct to save the state of the pool allocator. The pool hands out
+   * fixed-size blocks from one contiguous range, freed blocks are linked
+   * through their own memory so allocation and deallocation are O(1).
+   */
+  struct PoolAllocator {
+    void* memory;        // pointer to the first block
+    void* free_list;     // pointer to the first freed block, the next pointer lives inside the block
+    size_t block_size;   // in bytes, the stride between blocks
+    size_t block_count;  // amount of blocks in the pool
+    size_t next_unused;  // index of the first block that was never handed out
+    size_t used_count;   // amount of blocks currently handed out
+    size_t peak_count;   // highest used_count seen
+  };
+
+  /**
+   * Create a pool allocator that takes its memory from a bump allocator.
+   *
+   * @param backing The bump allocator to take the memory from.
+   * @param block_size The size of a block in bytes.
+   * @param block_count The amount of blocks in the pool.
+   * @param alignment The alignment of every block, must be a power of two.
+   * @return The pool allocator, with no memory if the backing allocator is full.
+   */
+  inline PoolAllocator create_pool(bump_allocator::BumpAllocator* backing, size_t block_size, size_t block_count,
+                                   size_t alignment = bump_allocator::cache_line_size) {
+    // Every block must be able to hold the free list pointer and keep the next block aligned.
+    if(block_size < sizeof(void*)) { block_size = sizeof(void*); }
+    block_size = (block_size + alignment - 1) & ~(alignment - 1);
+
+    PoolAllocator pool = {};
+    pool.memory        = bump_allocator::allocate(backing, block_size * block_count, alignment);
+    pool.block_size    = block_size;
+    pool.block_count   = pool.memory ? block_count : 0;
+
+    if(!pool.memory) { SM_CERROR(allocator, "Failed to allocate {} blocks for the pool allocator.", block_count); }
+
+    return pool;
+  }
+
+  /**
+   * Create a pool allocator for objects of type T, blocks are aligned to the
+   * larger of alignof(T) and the cache line size.
+   *
+   * @param backing The bump allocator to take the memory from.
+   * @param count The amount of objects in the pool.
+   * @return The pool allocator.
+   */
+  template <typename T>
+  PoolAllocator create_pool(bump_allocator::BumpAllocator* backing, size_t count) {
+    size_t alignment = alignof(T) > bump_allocator::cache_line_size ? alignof(T) : bump_allocator::cache_line_size;
+    return create_pool(backing, sizeof(T), count, alignment);
+  }
+
+  /**
+   * Check if a pointer belongs to the pool.
+   *
+   * @param pool The pool to check.
+   * @param block The pointer to check.
+   * @return Whether or not the pointer is a block of the pool.
+   */
+  inline bool owns(PoolAllocator* pool, void* block) {
+    uintptr_t start = (uintptr_t)pool->memory;
+    uintptr_t ptr   = (uintptr_t)block;
+
+    return ptr >= start && ptr < start + pool->block_size * pool->block_count &&
+           (ptr - start) % pool->block_size == 0;
+  }
+
+  /**
+   * Allocate a block from the pool in O(1).
+   *
+   * @param pool The pool to allocate from.
+   * @return The pointer to the block, or nullptr if the pool is full.
+   */
+  inline void* allocate(PoolAllocator* pool) {
+    void* block = pool->free_list;
+
+    if(block) {
+      pool->free_list = *(void**)block;
+    } else if(pool->next_unused < pool->block_count) {
+      block = (char*)pool->memory + pool->next_unused * pool->block_size;
+      pool->next_unused++;
+    } else {
+      SM_CERROR(allocator, "Failed to allocate from the pool allocator, all {} blocks are in use.", pool->block_count);
+      return nullptr;
+    }
+
+    pool->used_count++;
+#if SM_ALLOCATOR_STATS
+    if(pool->used_count > pool->peak_count) { pool->peak_count = pool->used_count; }
+    allocator_stats::record_block_allocation();
+#endif
+    SM_UNPOISON_MEMORY(block, pool->block_size);
+
+    return block;
+  }
+
+  /**
+   * Give a block back to the pool in O(1).
+   *
+   * @param pool The pool the block was allocated from.
+   * @param block The block to give back.
+   */
+  inline void deallocate(PoolAllocator* pool, void* block) {
+    if(!block) { return; }
+
+    SM_ASSERT(owns(pool, block), "Deallocating a block that does not belong to the pool allocator.");
+
+    // The free list pointer lives in the first bytes, only poison the rest of the block.
+    allocator_stats::poison((char*)block + sizeof(void*), pool->block_size - sizeof(void*));
+    allocator_stats::record_block_free();
+
+    *(void**)block  = pool->free_list;
+    pool->free_list = block;
+    pool->used_count--;
+  }
+
+  /**
+   * Construct an object of type T in a block of the pool.
+   *
+   * @param pool The pool to allocate from.
+   * @param args The arguments to construct the object with.
+   * @return The pointer to the object, or nullptr if the pool is full.
+   */
+  template <typename T, typename... Args>
+  T* create(PoolAllocator* pool, Args&&... args) {
+    SM_ASSERT(sizeof(T) <= pool->block_size, "Object does not fit in a block of the pool allocator.");
+
+    void* block = allocate(pool);
+    if(!block) { return nullptr; }
+
+    return new(block) T(std::forward<Args>(args)...);
+  }
+
+  /**
+   * Destroy an object created with create and give its block back to the pool.
+   *
+   * @param pool The pool the object was created in.
+   * @param object The object to destroy.
+   */
+  template <typename T>
+  void destroy(PoolAllocator* pool, T* object) {
+    if(!object) { return; }
+
+    object->~T();
+    deallocate(pool, object);
+  }
+
+  /**
+   * Give every block back to the pool in O(1), unless released memory is
+   * poisoned. Destructors are not run.
+   *
+   * @param pool The pool to reset.
+   */
+  inline void reset(PoolAllocator* pool) {
+    allocator_stats::poison(pool->memory, pool->next_unused * pool->block_size);
+    allocator_stats::record_block_free(pool->used_count);
+
+    pool->free_list   = nullptr;
+    pool->next_unused = 0;
+    pool->used_count  = 0;
+  }
+}  // namespace pool_allocator
+
+#endif  // _POOL_ALLOCATOR_H
@@ -0,0 +1,380 @@
+#pragma once
+#ifndef _TLSF_ALLOCATOR_H
+#define _TLSF_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "bump_allocator.hpp"
+#include "logger.hpp"
+
+// Two-Level Segregated Fit heap. Free blocks are kept in segregated lists
+// indexed by a first level (power of two) and a second level (linear
+// subdivision of that power of two). Two bitmaps find a non-empty list with
+// a couple of bit scans, so allocate and deallocate are O(1) whatever the
+// heap size or fragmentation, which keeps asset churn from spiking frames.
+namespace tlsf_allocator {
+  /**
+   * Alignment of every allocation and granularity of block sizes.
+   */
+  inline constexpr size_t align_size = 16;
+
+  /**
+   * Log2 of the amount of second level lists per first level.
+   */
+  inline constexpr int sl_index_count_log2 = 4;
+  inline constexpr int sl_index_count      = 1 << sl_index_count_log2;
+
+  /**
+   * Blocks smaller than small_block_size all go in first level 0, split
+   * linearly in align_size steps.
+   */
+  inline constexpr int fl_index_shift      = sl_index_count_log2 + 4;  // 4 is log2(align_size)
+  inline constexpr int fl_index_max        = 40;                       // blocks below 1 TiB
+  inline constexpr int fl_index_count      = fl_index_max - fl_index_shift + 1;
+  inline constexpr size_t small_block_size = (size_t)1 << fl_index_shift;
+  inline constexpr size_t block_size_max   = (size_t)1 << fl_index_max;  // exclusive, it would map past the last level
+
+  /**
+   * Flags stored in the low bits of Block::size, sizes are multiples of align_size.
+   */
+  inline constexpr size_t block_free_bit      = 1;  // the block is free
+  inline constexpr size_t block_prev_free_bit = 2;  // the previous physical block is free
+
+  /**
+   * Header in front of every block. next_free and prev_free overlap the
+   * payload and are only valid while the block is free.
+   */
+  struct Block {
+    Block* prev_physical;  // the block right before this one in memory
+    size_t size;           // in bytes, the payload size with the two flag bits
+    Block* next_free;      // next block in the same free list
+    Block* prev_free;      // previous block in the same free list
+  };
+
+  inline constexpr size_t block_header_size = offsetof(Block, next_free);
+  inline constexpr size_t block_size_min    = sizeof(Block) - block_header_size;
+
+  /**
+   * Struct to save the state of the TLSF allocator.
+   */
+  struct TlsfAllocator {
+    void* memory;                                       // pointer to the memory
+    size_t capacity;                                    // in bytes
+    uint64_t fl_bitmap;                                 // bit set for every first level with free blocks
+    uint32_t sl_bitmap[fl_index_count];                 // bit set for every non-empty second level list
+    Block* free_lists[fl_index_count][sl_index_count];  // heads of the segregated free lists
+    size_t used_bytes;                                  // payload bytes handed out
+    size_t peak_bytes;                                  // highest used_bytes seen
+    size_t free_bytes;                                  // payload bytes in free blocks
+    size_t free_block_count;                            // amount of free blocks
+    size_t allocation_count;                            // amount of live allocations
+  };
+
+  /**
+   * Fragmentation statistics, gathered by walking every block.
+   */
+  struct Stats {
+    size_t used_bytes;          // payload bytes handed out
+    size_t peak_bytes;          // highest used_bytes seen
+    size_t free_bytes;          // payload bytes in free blocks
+    size_t free_block_count;    // amount of free blocks
+    size_t largest_free_block;  // in bytes, the largest allocation that can succeed
+    size_t allocation_count;    // amount of live allocations
+    float fragmentation;        // 0 when all free memory is one block, towards 1 as it splinters
+  };
+
+  inline size_t get_block_size(Block* block) { return block->size & ~(block_free_bit | block_prev_free_bit); }
+
+  inline void set_block_size(Block* block, size_t size) {
+    block->size = size | (block->size & (block_free_bit | block_prev_free_bit));
+  }
+
+  inline void* get_payload(Block* block) { return (char*)block + block_header_size; }
+
+  inline Block* get_block(void* payload) { return (Block*)((char*)payload - block_header_size); }
+
+  inline Block* get_next_physical(Block* block) {
+    return (Block*)((char*)get_payload(block) + get_block_size(block));
+  }
+
+  /**
+   * Index of the highest set bit.
+   */
+  inline int find_last_set(size_t value) { return 63 - __builtin_clzll((unsigned long long)value); }
+
+  /**
+   * Index of the lowest set bit.
+   */
+  inline int find_first_set(uint64_t value) { return __builtin_ctzll((unsigned long long)value); }
+
+  /**
+   * Get the free list a block of the given size belongs to.
+   *
+   * @param size The payload size of the block.
+   * @param fl The first level index.
+   * @param sl The second level index.
+   */
+  inline void mapping_insert(size_t size, int* fl, int* sl) {
+    if(size < small_block_size) {
+      *fl = 0;
+      *sl = (int)(size / (small_block_size / sl_index_count));
+    } else {
+      int last = find_last_set(size);
+      *sl      = (int)(size >> (last - sl_index_count_log2)) ^ sl_index_count;
+      *fl      = last - (fl_index_shift - 1);
+    }
+  }
+
+  /**
+   * Get the first free list whose blocks are all large enough for the size,
+   * by rounding the size up to the next list boundary.
+   *
+   * @param size The requested payload size.
+   * @param fl The first level index.
+   * @param sl The second level index.
+   */
+  inline void mapping_search(size_t size, int* fl, int* sl) {
+    if(size >= small_block_size) { size += ((size_t)1 << (find_last_set(size) - sl_index_count_log2)) - 1; }
+    mapping_insert(size, fl, sl);
+  }
+
+  inline void insert_free_block(TlsfAllocator* heap, Block* block) {
+    int fl, sl;
+    mapping_insert(get_block_size(block), &fl, &sl);
+
+    Block* head      = heap->free_lists[fl][sl];
+    block->next_free = head;
+    block->prev_free = nullptr;
+    if(head) { head->prev_free = block; }
+
+    heap->free_lists[fl][sl] = block;
+    heap->fl_bitmap |= (uint64_t)1 << fl;
+    heap->sl_bitmap[fl] |= 1u << sl;
+
+    heap->free_bytes += get_block_size(block);
+    heap->free_block_count++;
+  }
+
+  inline void remove_free_block(TlsfAllocator* heap, Block* block) {
+    int fl, sl;
+    mapping_insert(get_block_size(block), &fl, &sl);
+
+    if(block->prev_free) { block->prev_free->next_free = block->next_free; }
+    if(block->next_free) { block->next_free->prev_free = block->prev_free; }
+
+    if(heap->free_lists[fl][sl] == block) {
+      heap->free_lists[fl][sl] = block->next_free;
+
+      if(!block->next_free) {
+        heap->sl_bitmap[fl] &= ~(1u << sl);
+        if(!heap->sl_bitmap[fl]) { heap->fl_bitmap &= ~((uint64_t)1 << fl); }
+      }
+    }
+
+    heap->free_bytes -= get_block_size(block);
+    heap->free_block_count--;
+  }
+
+  /**
+   * Find a free block of at least the list size of fl/sl with two bit scans.
+   */
+  inline Block* find_suitable_block(TlsfAllocator* heap, int fl, int sl) {
+    uint32_t sl_map = heap->sl_bitmap[fl] & (~0u << sl);
+
+    if(!sl_map) {
+      uint64_t fl_map = fl + 1 < fl_index_count ? heap->fl_bitmap & (~(uint64_t)0 << (fl + 1)) : 0;
+      if(!fl_map) { return nullptr; }
+
+      fl     = find_first_set(fl_map);
+      sl_map = heap->sl_bitmap[fl];
+    }
+
+    return heap->free_lists[fl][find_first_set(sl_map)];
+  }
+
+  /**
+   * Create a TLSF allocator that takes one large block from a bump allocator,
+   * usually the permanent storage.
+   *
+   * @param backing The bump allocator to take the memory from.
+   * @param size The size of the heap in bytes.
+   * @return The TLSF allocator, with no memory if the backing allocator is full.
+   */
+  inline TlsfAllocator create_allocator(bump_allocator::BumpAllocator* backing, size_t size) {
+    TlsfAllocator heap = {};
+
+    // One header for the first free block and one for the sentinel at the end.
+    size = size & ~(align_size - 1);
+    if(size < 2 * block_header_size + block_size_min || size - 2 * block_header_size >= block_size_max) {
+      SM_CERROR(allocator, "Invalid size for the TLSF allocator: {} bytes.", size);
+      return heap;
+    }
+
+    heap.memory = bump_allocator::allocate(backing, size, align_size);
+    if(!heap.memory) {
+      SM_CERROR(allocator, "Failed to allocate {} bytes of memory for the TLSF allocator.", size);
+      return heap;
+    }
+
+    heap.capacity = size;
+
+    Block* block         = (Block*)heap.memory;
+    block->prev_physical = nullptr;
+    block->size          = (size - 2 * block_header_size) | block_free_bit;
+
+    // The sentinel is never free, so blocks never merge past the end.
+    Block* sentinel         = get_next_physical(block);
+    sentinel->prev_physical = block;
+    sentinel->size          = 0 | block_prev_free_bit;
+
+    insert_free_block(&heap, block);
+
+    return heap;
+  }
+
+  /**
+   * Allocate memory from the TLSF allocator in O(1). The memory is aligned to
+   * align_size.
+   *
+   * @param heap The allocator to allocate memory from.
+   * @param size The size of the memory to allocate.
+   * @return The pointer to the allocated memory.
+   */
+  inline void* allocate(TlsfAllocator* heap, size_t size) {
+    size_t adjusted = size < block_size_min ? block_size_min : (size + align_size - 1) & ~(align_size - 1);
+
+    int fl = 0, sl = 0;
+    if(adjusted < block_size_max) { mapping_search(adjusted, &fl, &sl); }
+
+    Block* block = fl < fl_index_count && adjusted < block_size_max ? find_suitable_block(heap, fl, sl) : nullptr;
+    if(!block) {
+      SM_CERROR(allocator, "Failed to allocate {} bytes from the TLSF allocator, no free block is large enough.", size);
+      return nullptr;
+    }
+
+    remove_free_block(heap, block);
+
+    // Split off the tail of the block if it can hold another block.
+    size_t block_size = get_block_size(block);
+    if(block_size >= adjusted + block_header_size + block_size_min) {
+      Block* remaining         = (Block*)((char*)get_payload(block) + adjusted);
+      remaining->prev_physical = block;
+      remaining->size          = (block_size - adjusted - block_header_size) | block_free_bit;
+      set_block_size(block, adjusted);
+
+      get_next_physical(remaining)->prev_physical = remaining;
+      insert_free_block(heap, remaining);
+    } else {
+      get_next_physical(block)->size &= ~block_prev_free_bit;
+    }
+
+    block->size &= ~block_free_bit;
+
+    heap->used_bytes += get_block_size(block);
+    if(heap->used_bytes > heap->peak_bytes) { heap->peak_bytes = heap->used_bytes; }
+    heap->allocation_count++;
+
+    return get_payload(block);
+  }
+
+  /**
+   * Allocate uninitialized memory for `count` objects of type T.
+   *
+   * @param heap The allocator to allocate memory from.
+   * @param count The amount of objects to allocate.
+   * @return The pointer to the first object.
+   */
+  template <typename T>
+  T* allocate(TlsfAllocator* heap, size_t count = 1) {
+    static_assert(alignof(T) <= align_size, "The TLSF allocator only aligns to align_size.");
+    return (T*)allocate(heap, sizeof(T) * count);
+  }
+
+  /**
+   * Give memory back to the TLSF allocator in O(1), merging it with its free
+   * neighbours.
+   *
+   * @param heap The allocator the memory was allocated from.
+   * @param memory The memory to give back.
+   */
+  inline void deallocate(TlsfAllocator* heap, void* memory) {
+    if(!memory) { return; }
+
+    Block* block = get_block(memory);
+    SM_ASSERT(!(block->size & block_free_bit), "Deallocating memory that is already free in the TLSF allocator.");
+
+    heap->used_bytes -= get_block_size(block);
+    heap->allocation_count--;
+
+    block->size |= block_free_bit;
+
+    // Merge with the previous block.
+    if(block->size & block_prev_free_bit) {
+      Block* prev = block->prev_physical;
+      remove_free_block(heap, prev);
+      set_block_size(prev, get_block_size(prev) + block_header_size + get_block_size(block));
+      block = prev;
+    }
+
+    // Merge with the next block.
+    Block* next = get_next_physical(block);
+    if(next->size & block_free_bit) {
+      remove_free_block(heap, next);
+      set_block_size(block, get_block_size(block) + block_header_size + get_block_size(next));
+      next = get_next_physical(block);
+    }
+
+    next->prev_physical = block;
+    next->size |= block_prev_free_bit;
+
+    insert_free_block(heap, block);
+  }
+
+  /**
+   * Gather the fragmentation statistics of the heap. This walks every block,
+   * so it is meant for debug overlays and dumps, not the hot path.
+   *
+   * @param heap The allocator to inspect.
+   * @return The statistics.
+   */
+  inline Stats get_stats(TlsfAllocator* heap) {
+    Stats stats            = {};
+    stats.used_bytes       = heap->used_bytes;
+    stats.peak_bytes       = heap->peak_bytes;
+    stats.free_bytes       = heap->free_bytes;
+    stats.free_block_count = heap->free_block_count;
+    stats.allocation_count = heap->allocation_count;
+
+    if(!heap->memory) { return stats; }
+
+    for(Block* block = (Block*)heap->memory; get_block_size(block); block = get_next_physical(block)) {
+      if((block->size & block_free_bit) && get_block_size(block) > stats.largest_free_block) {
+        stats.largest_free_block = get_block_size(block);
+      }
+    }
+
+    if(stats.free_bytes) { stats.fragmentation = 1.0f - (float)stats.largest_free_block / (float)stats.free_bytes; }
+
+    return stats;
+  }
+
+  /**
+   * Log the statistics of the heap.
+   *
+   * @param heap The allocator to log.
+   */
+  inline void dump(TlsfAllocator* heap) {
+    Stats stats = get_stats(heap);
+
+    char line[256];
+    snprintf(line, sizeof(line),
+             "tlsf %12zu used %12zu peak %12zu free in %zu blocks, largest %zu, fragmentation %.2f, %zu allocations",
+             stats.used_bytes, stats.peak_bytes, stats.free_bytes, stats.free_block_count, stats.largest_free_block,
+             stats.fragmentation, stats.allocation_count);
+    SM_CINFO(allocator, "{}", line);
+  }
+}  // namespace tlsf_allocator
+
+#endif  // _TLSF_ALLOCATOR_H
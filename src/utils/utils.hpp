@@ -2,19 +2,325 @@
 #ifndef _UTILS_HPP
 #define _UTILS_HPP
 
+#ifdef _WIN32
 #include <Windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 
+#include "bump_allocator.hpp"
+
 namespace utils {
+  /**
+   * Why a file could not be read.
+   */
+  enum class file_error
+  {
+    none,           // the file was read
+    not_found,      // the file does not exist
+    access_denied,  // the file exists but can't be opened
+    too_large,      // the file doesn't fit in the destination, the result holds the size it needs
+    out_of_memory,  // the allocator has no room for the file
+    read_failed     // the file was opened but reading it failed
+  };
+
+  /**
+   * Result of reading a file.
+   */
+  struct FileResult {
+    char* data;        // the contents followed by a null terminator, nullptr on error
+    size_t size;       // size of the contents in bytes, without the null terminator
+    file_error error;  // file_error::none on success
+  };
+
+  /**
+   * An open file and its size.
+   */
+  struct OpenFile {
+#ifdef _WIN32
+    HANDLE handle;  // the file
+#else
+    int handle;  // the file descriptor
+#endif
+    size_t size;       // size of the file in bytes
+    file_error error;  // file_error::none if the file is open
+  };
+
+  /**
+   * Open a file for reading in binary mode and get its size, with one open
+   * and one fstat.
+   *
+   * @param file_path The path to the file to open.
+   * @return The open file, check its error.
+   */
+  inline OpenFile open_file(const char* file_path) {
+    OpenFile file = {};
+
+#ifdef _WIN32
+    file.handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if(file.handle == INVALID_HANDLE_VALUE) {
+      DWORD error = GetLastError();
+      file.error  = error == ERROR_FILE_NOT_FOUND || error == ERROR_PATH_NOT_FOUND ? file_error::not_found
+                                                                                   : file_error::access_denied;
+      return file;
+    }
+
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(file.handle, &size)) {
+      CloseHandle(file.handle);
+      file.error = file_error::read_failed;
+      return file;
+    }
+    file.size = (size_t)size.QuadPart;
+#else
+    file.handle = open(file_path, O_RDONLY | O_CLOEXEC);
+    if(file.handle == -1) {
+      file.error = errno == ENOENT || errno == ENOTDIR ? file_error::not_found : file_error::access_denied;
+      return file;
+    }
+
+    struct stat st;
+    if(fstat(file.handle, &st) == -1 || !S_ISREG(st.st_mode)) {
+      close(file.handle);
+      file.error = file_error::read_failed;
+      return file;
+    }
+    file.size = (size_t)st.st_size;
+#endif
+
+    return file;
+  }
+
+  /**
+   * Close a file opened with open_file.
+   *
+   * @param file The file to close.
+   */
+  inline void close_file(OpenFile* file) {
+#ifdef _WIN32
+    CloseHandle(file->handle);
+#else
+    close(file->handle);
+#endif
+  }
+
+  /**
+   * Read the whole contents of an open file straight into memory, without
+   * going through a stdio buffer.
+   *
+   * @param file The file to read.
+   * @param destination Where to read the contents to, at least file->size bytes.
+   * @return Whether or not the whole file was read.
+   */
+  inline bool read_contents(OpenFile* file, char* destination) {
+    size_t done = 0;
+
+    while(done < file->size) {
+#ifdef _WIN32
+      // ReadFile takes 32-bit sizes.
+      size_t left = file->size - done;
+      DWORD chunk = left > (1u << 30) ? (1u << 30) : (DWORD)left;
+      DWORD bytes = 0;
+      if(!ReadFile(file->handle, destination + done, chunk, &bytes, nullptr) || bytes == 0) { return false; }
+#else
+      ssize_t bytes = read(file->handle, destination + done, file->size - done);
+      if(bytes == -1 && errno == EINTR) { continue; }
+      if(bytes <= 0) { return false; }
+#endif
+      done += (size_t)bytes;
+    }
+
+    return true;
+  }
+
+  /**
+   * Read a whole file in binary mode into a bump allocator, followed by a
+   * null terminator. One open, one fstat and one read per file, and nothing
+   * is taken from the allocator if reading fails.
+   *
+   * @param file_path The path to the file to read.
+   * @param allocator The allocator to read the file into.
+   * @param alignment The alignment of the contents, a power of two.
+   * @return The contents, their size and the error.
+   */
+  inline FileResult read_file(const char* file_path, bump_allocator::BumpAllocator* allocator,
+                              size_t alignment = bump_allocator::default_alignment) {
+    OpenFile file = open_file(file_path);
+    if(file.error != file_error::none) { return {nullptr, 0, file.error}; }
+
+    bump_allocator::Marker marker = bump_allocator::get_marker(allocator);
+    char* data                    = (char*)bump_allocator::allocate(allocator, file.size + 1, alignment);
+    if(!data) {
+      close_file(&file);
+      return {nullptr, file.size, file_error::out_of_memory};
+    }
+
+    bool read = read_contents(&file, data);
+    close_file(&file);
+
+    if(!read) {
+      bump_allocator::rollback(allocator, marker);
+      return {nullptr, 0, file_error::read_failed};
+    }
+
+    data[file.size] = '\0';
+    return {data, file.size, file_error::none};
+  }
+
+  /**
+   * Read a whole file in binary mode into a caller buffer, followed by a
+   * null terminator.
+   *
+   * @param file_path The path to the file to read.
+   * @param buffer The buffer to read the file into.
+   * @param capacity The size of the buffer in bytes, the file size + 1 at least.
+   * @return The contents, their size and the error. When the buffer is too small the size is still set.
+   */
+  inline FileResult read_file(const char* file_path, char* buffer, size_t capacity) {
+    OpenFile file = open_file(file_path);
+    if(file.error != file_error::none) { return {nullptr, 0, file.error}; }
+
+    if(file.size + 1 > capacity) {
+      close_file(&file);
+      return {nullptr, file.size, file_error::too_large};
+    }
+
+    bool read = read_contents(&file, buffer);
+    close_file(&file);
+
+    if(!read) { return {nullptr, 0, file_error::read_failed}; }
+
+    buffer[file.size] = '\0';
+    return {buffer, file.size, file_error::none};
+  }
+
+  /**
+   * How a mapped file is going to be read, lets the OS read ahead or not.
+   */
+  enum class access_hint
+  {
+    normal,      // no hint
+    sequential,  // read once from start to end, pages can be dropped behind the reader
+    random,      // read in no particular order, reading ahead is wasted
+    will_need    // read soon, start loading the whole file now
+  };
+
+  /**
+   * A read-only view of a whole file mapped into memory. The pages are shared
+   * with the OS page cache, nothing is copied and the OS can evict them.
+   */
+  struct FileView {
+    const char* data;  // the contents, not null terminated, nullptr for empty files and on error
+    size_t size;       // size of the contents in bytes
+    file_error error;  // file_error::none on success
+#ifdef _WIN32
+    HANDLE mapping;  // the file mapping object
+#endif
+  };
+
+  /**
+   * Map a whole file read-only into memory. The view stays valid after the
+   * file is closed, until unmap_file. Modifying the file while it's mapped
+   * changes the contents under the view.
+   *
+   * @param file_path The path to the file to map.
+   * @param hint How the view is going to be read.
+   * @return The view, check its error.
+   */
+  inline FileView map_file(const char* file_path, access_hint hint = access_hint::normal) {
+    FileView view = {};
+
+    OpenFile file = open_file(file_path);
+    if(file.error != file_error::none) {
+      view.error = file.error;
+      return view;
+    }
+
+    // Empty files can't be mapped, they are an empty view.
+    if(file.size == 0) {
+      close_file(&file);
+      return view;
+    }
+
+#ifdef _WIN32
+    view.mapping = CreateFileMappingA(file.handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    close_file(&file);
+    if(!view.mapping) {
+      view.error = file_error::out_of_memory;
+      return view;
+    }
+
+    view.data = (const char*)MapViewOfFile(view.mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!view.data) {
+      CloseHandle(view.mapping);
+      view.mapping = nullptr;
+      view.error   = file_error::out_of_memory;
+      return view;
+    }
+
+    if(hint == access_hint::will_need) {
+#if defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0602
+      WIN32_MEMORY_RANGE_ENTRY range = {(void*)view.data, file.size};
+      PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+      // PrefetchVirtualMemory needs Windows 8, older targets fault the pages in one by one.
+      const size_t page_size = 4096;
+      for(size_t offset = 0; offset < file.size; offset += page_size) {
+        (void)*(volatile const char*)(view.data + offset);
+      }
+#endif
+    }
+#else
+    void* data = mmap(nullptr, file.size, PROT_READ, MAP_PRIVATE, file.handle, 0);
+    close_file(&file);
+    if(data == MAP_FAILED) {
+      view.error = file_error::out_of_memory;
+      return view;
+    }
+
+    const int advice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED};
+    if(hint != access_hint::normal) { madvise(data, file.size, advice[(int)hint]); }
+
+    view.data = (const char*)data;
+#endif
+
+    view.size = file.size;
+    return view;
+  }
+
+  /**
+   * Unmap a file mapped with map_file, its data must not be used anymore.
+   *
+   * @param view The view to unmap.
+   */
+  inline void unmap_file(FileView* view) {
+    if(view->data) {
+#ifdef _WIN32
+      UnmapViewOfFile(view->data);
+      CloseHandle(view->mapping);
+#else
+      munmap((void*)view->data, view->size);
+#endif
+    }
+
+    *view = {};
+  }
+
   /**
    * Get the timestamp of a file.
    *
    * @param file The file to get the timestamp of.
    * @return The timestamp of the file.
    */
-  long long get_timestamp(char* file) {
+  inline long long get_timestamp(char* file) {
     struct stat st = {};
 
     if(stat(file, &st) == -1) { return -1; }
@@ -28,13 +334,9 @@ namespace utils {
    * @param file_path The path to the file to check.
    * @return Whether or not the file exists.
    */
-  bool file_exists(char* file_path) {
-    if(FILE* file = fopen(file_path, "r")) {
-      fclose(file);
-      return true;
-    } else {
-      return false;
-    }
+  inline bool file_exists(char* file_path) {
+    struct stat st = {};
+    return stat(file_path, &st) == 0;
   }
 
   /**
@@ -43,35 +345,35 @@ namespace utils {
    * @param file_path The path to the file to get the size of.
    * @return The size of the file.
    */
-  long get_file_size(char* file_path) {
-    if(!file_exists(file_path)) { return -1; }
+  inline long get_file_size(char* file_path) {
+    struct stat st = {};
 
-    FILE* file = fopen(file_path, "r");
-    fseek(file, 0, SEEK_END);
-    long size = ftell(file);
-    fclose(file);
+    if(stat(file_path, &st) == -1) { return -1; }
 
-    return size;
+    return (long)st.st_size;
   }
 
   /**
-   * Read a file.
+   * Read a file into memory allocated with malloc. Prefer the overloads
+   * reading into a bump allocator or a caller buffer.
    *
    * @param file_path The path to the file to read.
-   * @return The contents of the file.
+   * @return The contents of the file, null terminated, to free. nullptr on error.
    */
-  char* read_file(char* file_path) {
-    if(!file_exists(file_path)) { return nullptr; }
+  inline char* read_file(char* file_path) {
+    OpenFile file = open_file(file_path);
+    if(file.error != file_error::none) { return nullptr; }
 
-    FILE* file = fopen(file_path, "r");
-    long size  = get_file_size(file_path);
-    char* data = (char*)malloc(size + 1);
+    char* data = (char*)malloc(file.size + 1);
+    bool read  = data && read_contents(&file, data);
+    close_file(&file);
 
-    fread(data, size, 1, file);
-    data[size] = '\0';
-
-    fclose(file);
+    if(!read) {
+      free(data);
+      return nullptr;
+    }
 
+    data[file.size] = '\0';
     return data;
   }
 
@@ -81,7 +383,7 @@ namespace utils {
    * @param file_path The path to the file to write to.
    * @param data The data to write to the file.
    */
-  void write_file(char* file_path, char* data) {
+  inline void write_file(char* file_path, char* data) {
     FILE* file = fopen(file_path, "w");
     fwrite(data, strlen(data), 1, file);
     fclose(file);
@@ -93,7 +395,7 @@ namespace utils {
    * @param source The source file to copy.
    * @param destination The destination to copy the file to.
    */
-  void copy_file(char* source, char* destination) {
+  inline void copy_file(char* source, char* destination) {
     FILE* source_file      = fopen(source, "r");
     FILE* destination_file = fopen(destination, "w");
 
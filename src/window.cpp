@@ -1,3 +1,6 @@
+// Win32/WGL platform backend. Headless builds use window_headless.cpp instead.
+#ifndef SM_HEADLESS
+
 // For now, the load_gl_function is inside the gl_renderer.hpp file,
 // this will be changed in the future. This function must be defined in a
 // helper/utility file for the opengl library.
@@ -225,7 +228,7 @@ namespace window {
       int pixel_format = 0;
 
       if(!wglChoosePixelFormatARB(hdc, pixel_attribs, 0, 1, &pixel_format, &num_formats)) {
-        logger::log("Failed to choose pixel format.", "Error", logger::color::red);
+        SM_CERROR(window, "Failed to choose pixel format.");
         return false;
       }
 
@@ -233,7 +236,7 @@ namespace window {
       DescribePixelFormat(hdc, pixel_format, sizeof(PIXELFORMATDESCRIPTOR), &pfd);
 
       if(!SetPixelFormat(hdc, pixel_format, &pfd)) {
-        logger::log("Failed to set pixel format.", "Error", logger::color::red);
+        SM_CERROR(window, "Failed to set pixel format.");
         return false;
       }
 
@@ -252,12 +255,12 @@ namespace window {
 
       HGLRC gl_context = wglCreateContextAttribsARB(hdc, 0, context_attribs);
       if(!gl_context) {
-        logger::log("Failed to create OpenGL context.", "Error", logger::color::red);
+        SM_CERROR(window, "Failed to create OpenGL context.");
         return false;
       }
 
       if(!wglMakeCurrent(hdc, gl_context)) {
-        logger::log("Failed to make OpenGL context current.", "Error", logger::color::red);
+        SM_CERROR(window, "Failed to make OpenGL context current.");
         return false;
       }
     }
@@ -278,4 +281,6 @@ namespace window {
       DispatchMessageA(&msg);
     }
   }
-}  // namespace window
\ No newline at end of file
+}  // namespace window
+
+#endif  // SM_HEADLESS
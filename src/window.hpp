@@ -12,8 +12,10 @@
 #include <string>
 
 namespace window {
+#ifdef _WIN32
   static HWND window;
   static int window_style = WS_OVERLAPPEDWINDOW;
+#endif
 
   /**
    * Main method to create a window.
@@ -29,10 +31,12 @@ namespace window {
    */
   void update_window();
 
+#ifdef _WIN32
   /**
    * Window callback
    */
   LRESULT CALLBACK window_callback(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
+#endif
 }  // namespace window
 
 #endif
\ No newline at end of file
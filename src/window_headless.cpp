@@ -0,0 +1,90 @@
+// Headless platform backend, compiled instead of window.cpp when SM_HEADLESS
+// is defined. It creates no window and no GL context, it only drives the
+// game loop and reports frame timings so the simulation can be benchmarked.
+#ifdef SM_HEADLESS
+
+#include "utils/logger.hpp"
+
+// Headers
+#include "game.hpp"
+#include "window.hpp"
+
+// Libs
+// clang-format off
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+// clang-format on
+
+namespace window {
+  using clock = std::chrono::steady_clock;
+
+  /**
+   * Default amount of frames to run when SM_HEADLESS_FRAMES is not set.
+   */
+  static const long long default_frame_count = 10000;
+
+  static long long frame_count = 0;
+  static long long frame_limit = default_frame_count;
+
+  static clock::time_point start_time;
+  static clock::time_point last_frame_time;
+
+  static double min_frame_ns   = 0.0;
+  static double max_frame_ns   = 0.0;
+  static double total_frame_ns = 0.0;
+
+  /**
+   * Log the frame timings collected since the window was created.
+   */
+  void log_frame_stats() {
+    double elapsed_ms = std::chrono::duration<double, std::milli>(clock::now() - start_time).count();
+    double average_ns = frame_count ? total_frame_ns / frame_count : 0.0;
+
+    char stats[256];
+    snprintf(stats, sizeof(stats), "%lld frames in %.3f ms (avg %.1f ns, min %.1f ns, max %.1f ns per frame)",
+             frame_count, elapsed_ms, average_ns, min_frame_ns, max_frame_ns);
+    SM_CINFO(window, "{}", stats);
+  }
+
+  /**
+   * Main method to create a window. In headless mode this only reads the
+   * frame limit from the SM_HEADLESS_FRAMES environment variable and starts
+   * the frame clock.
+   *
+   * @param width The width of the window.
+   * @param height The height of the window.
+   * @param title The title of the window.
+   */
+  bool create_window(int width, int height, std::string title) {
+    if(const char* frames = getenv("SM_HEADLESS_FRAMES")) { frame_limit = atoll(frames); }
+
+    SM_CTRACE(window, "Running '{}' ({}x{}) headless for {} frames.", title, width, height, frame_limit);
+
+    start_time      = clock::now();
+    last_frame_time = start_time;
+
+    return true;
+  }
+
+  /**
+   * Main method to update the window. In headless mode this records the
+   * frame time and stops the game once the frame limit is reached.
+   */
+  void update_window() {
+    clock::time_point now = clock::now();
+    double frame_ns       = std::chrono::duration<double, std::nano>(now - last_frame_time).count();
+    last_frame_time       = now;
+
+    if(frame_count == 0 || frame_ns < min_frame_ns) { min_frame_ns = frame_ns; }
+    if(frame_ns > max_frame_ns) { max_frame_ns = frame_ns; }
+    total_frame_ns += frame_ns;
+
+    if(++frame_count >= frame_limit) {
+      game::running = false;
+      log_frame_stats();
+    }
+  }
+}  // namespace window
+
+#endif  // SM_HEADLESS
@@ -0,0 +1,247 @@
+// Decoder for the binary log files written by logger::start_binary. Formats
+// every record back into text, in the order they were logged.
+// Build with `sh build.sh tools` and run build/log_decode <file>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/logger.hpp"
+
+namespace {
+  /**
+   * A call site as described in the stream.
+   */
+  struct Site {
+    int level;                // level of the records
+    int category;             // category of the records
+    int line;                 // source line of the call site
+    std::string_view file;    // source file of the call site
+    std::string_view format;  // the format string
+    std::string_view types;   // type codes of the arguments
+  };
+
+  /**
+   * Read cursor over the bytes of the file, reads past the end fail the cursor.
+   */
+  struct Reader {
+    const unsigned char* data;  // the bytes
+    size_t size;                // in bytes
+    size_t offset;              // next byte to read
+    bool failed;                // set when a read went past the end
+  };
+
+  /**
+   * Read a little endian integer.
+   *
+   * @param reader The reader to read from.
+   * @param size The size of the integer in bytes.
+   * @return The integer, 0 if the reader ran out of bytes.
+   */
+  uint64_t read_fixed(Reader* reader, size_t size) {
+    if(reader->size - reader->offset < size) {
+      reader->failed = true;
+      return 0;
+    }
+
+    uint64_t value = 0;
+    for(size_t i = 0; i < size; i++) { value |= (uint64_t)reader->data[reader->offset + i] << (8 * i); }
+    reader->offset += size;
+
+    return value;
+  }
+
+  /**
+   * Read an unsigned LEB128 varint.
+   *
+   * @param reader The reader to read from.
+   * @return The integer, 0 if the reader ran out of bytes.
+   */
+  uint64_t read_varint(Reader* reader) {
+    uint64_t value = 0;
+
+    for(int shift = 0; shift < 64; shift += 7) {
+      uint64_t byte = read_fixed(reader, 1);
+      if(reader->failed) { return 0; }
+
+      value |= (byte & 0x7f) << shift;
+      if(!(byte & 0x80)) { break; }
+    }
+
+    return value;
+  }
+
+  /**
+   * Read a run of bytes.
+   *
+   * @param reader The reader to read from.
+   * @param size The amount of bytes to read.
+   * @return The bytes, empty if the reader ran out of bytes.
+   */
+  std::string_view read_bytes(Reader* reader, size_t size) {
+    if(reader->size - reader->offset < size) {
+      reader->failed = true;
+      return {};
+    }
+
+    std::string_view bytes((const char*)reader->data + reader->offset, size);
+    reader->offset += size;
+
+    return bytes;
+  }
+
+  /**
+   * Decode one argument of a record and append it to the message. A cut
+   * string is appended as far as it goes, a cut number not at all.
+   *
+   * @param writer The message.
+   * @param payload The encoded arguments.
+   * @param type The type code of the argument.
+   */
+  void decode_arg(logger::Writer* writer, Reader* payload, char type) {
+    if(type == 's') {
+      size_t length = (size_t)read_varint(payload);
+      size_t left   = payload->size - payload->offset;
+      if(payload->failed) { return; }
+
+      logger::write_arg(writer, read_bytes(payload, length < left ? length : left));
+      if(length > left) { payload->failed = true; }
+      return;
+    }
+
+    uint64_t value = type == 'b' || type == 'c' ? read_fixed(payload, 1)
+                     : type == 'f'              ? read_fixed(payload, 8)
+                                                : read_varint(payload);
+    if(payload->failed) { return; }
+
+    switch(type) {
+      case 'b': logger::write_arg(writer, value != 0); break;
+      case 'c': logger::write_arg(writer, (char)value); break;
+      case 'i': logger::write_arg(writer, (long long)(value >> 1) ^ -(long long)(value & 1)); break;
+      case 'u': logger::write_arg(writer, (unsigned long long)value); break;
+      case 'f': {
+        double number;
+        memcpy(&number, &value, sizeof(number));
+        logger::write_arg(writer, number);
+        break;
+      }
+      case 'p': logger::write_arg(writer, (const void*)(uintptr_t)value); break;
+      default: payload->failed = true; break;
+    }
+  }
+
+  /**
+   * Format a record and print it, like the logger prints text records.
+   *
+   * @param site The call site that logged the record.
+   * @param seconds The time of the record since the logger started.
+   * @param frame The frame number of the record.
+   * @param thread The thread id of the record.
+   * @param payload The encoded arguments.
+   */
+  void print_record(const Site& site, double seconds, uint64_t frame, uint32_t thread, Reader* payload) {
+    char text[4096];
+    logger::Writer writer = {text, sizeof(text), 0};
+
+    // Same expansion as logger::format_to, with the arguments decoded on the way.
+    std::string format(site.format);
+    const char* cursor = format.c_str();
+    for(char type : site.types) {
+      if(!logger::write_until_placeholder(&writer, &cursor)) { break; }
+      decode_arg(&writer, payload, type);
+      if(payload->failed) { break; }
+    }
+    if(!payload->failed) { logger::write_until_placeholder(&writer, &cursor); }
+
+    const char* level    = site.level < (int)logger::level::count ? logger::level_names[site.level] : "?";
+    const char* category = site.category < (int)logger::category::count ? logger::category_names[site.category] : "?";
+
+    printf("[%12.6f f%llu t%u] [%s] [%s] %.*s%s\n", seconds, (unsigned long long)frame, thread, level, category,
+           (int)writer.length, text, payload->failed ? " (truncated)" : "");
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if(argc != 2) {
+    fprintf(stderr, "Usage: %s <binary log file>\n", argv[0]);
+    return 1;
+  }
+
+  FILE* file = fopen(argv[1], "rb");
+  if(!file) {
+    fprintf(stderr, "Failed to open '%s'.\n", argv[1]);
+    return 1;
+  }
+
+  std::vector<unsigned char> data;
+  unsigned char chunk[65536];
+  while(size_t read = fread(chunk, 1, sizeof(chunk), file)) { data.insert(data.end(), chunk, chunk + read); }
+  fclose(file);
+
+  Reader reader = {data.data(), data.size(), 0, false};
+  if(read_bytes(&reader, 8) != std::string_view("SMLOG\0\0\2", 8)) {
+    fprintf(stderr, "'%s' is not a binary log file.\n", argv[1]);
+    return 1;
+  }
+
+  // Ids are global to the process that logged, a file may only describe a few sparse ones.
+  std::unordered_map<uint32_t, Site> sites;
+  uint64_t base_ticks       = 0;
+  uint64_t ticks_per_second = 1000000000;
+
+  while(reader.offset < reader.size) {
+    char tag = (char)read_fixed(&reader, 1);
+
+    if(tag == 'C') {
+      base_ticks       = read_fixed(&reader, 8);
+      ticks_per_second = read_fixed(&reader, 8);
+      if(!ticks_per_second) { ticks_per_second = 1000000000; }
+    } else if(tag == 'D') {
+      uint32_t id   = (uint32_t)read_fixed(&reader, 4);
+      Site site     = {};
+      site.level    = (int)read_fixed(&reader, 1);
+      site.category = (int)read_fixed(&reader, 1);
+      site.line     = (int)read_fixed(&reader, 4);
+      site.file     = read_bytes(&reader, read_fixed(&reader, 2));
+      site.format   = read_bytes(&reader, read_fixed(&reader, 2));
+      site.types    = read_bytes(&reader, read_fixed(&reader, 1));
+
+      if(reader.failed) { break; }
+
+      // Ids start at 1, 0 is never written.
+      if(!id) {
+        fprintf(stderr, "Corrupt call site description at offset %zu.\n", reader.offset);
+        return 1;
+      }
+      sites[id] = site;
+    } else if(tag == 'E') {
+      uint32_t id           = (uint32_t)read_fixed(&reader, 4);
+      uint64_t time         = read_fixed(&reader, 8);
+      uint64_t frame        = read_fixed(&reader, 4);
+      uint32_t thread       = (uint32_t)read_fixed(&reader, 2);
+      std::string_view args = read_bytes(&reader, read_fixed(&reader, 2));
+      if(reader.failed) { break; }
+
+      auto site = sites.find(id);
+      if(site == sites.end()) {
+        fprintf(stderr, "Record of unknown call site %u at offset %zu.\n", id, reader.offset);
+        continue;
+      }
+
+      double seconds = (double)(int64_t)(time - base_ticks) / (double)ticks_per_second;
+      Reader payload = {(const unsigned char*)args.data(), args.size(), 0, false};
+      print_record(site->second, seconds, frame, thread, &payload);
+    } else {
+      fprintf(stderr, "Corrupt record at offset %zu.\n", reader.offset - 1);
+      return 1;
+    }
+  }
+
+  if(reader.failed) { fprintf(stderr, "The file ends with an incomplete record, it was cut.\n"); }
+
+  return 0;
+}
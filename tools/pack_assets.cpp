@@ -0,0 +1,180 @@
+// Packer for the asset archives read by archive::open_archive. Packs every
+// file under a directory, named by its path relative to the directory.
+// Build with `sh build.sh tools` and run build/pack_assets <directory> <archive>.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "utils/archive.hpp"
+
+namespace {
+  /**
+   * A file to pack.
+   */
+  struct Asset {
+    std::string name;            // path relative to the packed directory, '/' separators
+    std::filesystem::path path;  // path to read the file from
+    uint64_t hash;               // archive::hash_name of the name
+    uint64_t size;               // size of the file in bytes
+    uint64_t offset;             // offset of the file in the archive
+  };
+
+  /**
+   * Round an offset up to the blob alignment.
+   *
+   * @param offset The offset to align.
+   * @return The aligned offset.
+   */
+  uint64_t align_offset(uint64_t offset) {
+    return (offset + archive::blob_alignment - 1) & ~(uint64_t)(archive::blob_alignment - 1);
+  }
+
+  /**
+   * Write bytes to the end of the archive.
+   *
+   * @param data The bytes to write.
+   * @param size The amount of bytes.
+   * @param output The archive.
+   * @return Whether or not every byte was written.
+   */
+  bool write_bytes(const void* data, size_t size, FILE* output) { return fwrite(data, 1, size, output) == size; }
+
+  /**
+   * Copy a file to the end of the archive.
+   *
+   * @param asset The file to copy.
+   * @param output The archive.
+   * @return Whether or not the whole file was copied.
+   */
+  bool copy_asset(const Asset& asset, FILE* output) {
+    FILE* input = fopen(asset.path.string().c_str(), "rb");
+    if(!input) { return false; }
+
+    uint64_t copied = 0;
+    char chunk[65536];
+    while(size_t read = fread(chunk, 1, sizeof(chunk), input)) {
+      if(fwrite(chunk, 1, read, output) != read) { break; }
+      copied += read;
+    }
+    fclose(input);
+
+    return copied == asset.size;
+  }
+}  // namespace
+
+int main(int argc, char** argv) {
+  if(argc != 3) {
+    fprintf(stderr, "Usage: %s <directory> <archive>\n", argv[0]);
+    return 1;
+  }
+
+  std::filesystem::path root = argv[1];
+  std::error_code error;
+  if(!std::filesystem::is_directory(root, error)) {
+    fprintf(stderr, "'%s' is not a directory.\n", argv[1]);
+    return 1;
+  }
+
+  // Every call takes the error code, a file vanishing or unreadable mid-listing is reported instead of thrown.
+  std::vector<Asset> assets;
+  std::filesystem::recursive_directory_iterator iterator(root, error);
+  for(; !error && iterator != std::filesystem::recursive_directory_iterator(); iterator.increment(error)) {
+    const std::filesystem::directory_entry& entry = *iterator;
+
+    bool regular = entry.is_regular_file(error);
+    if(error) { break; }
+
+    // A previous archive inside the packed directory would be packed into the new one.
+    std::error_code different;
+    if(!regular || std::filesystem::equivalent(entry.path(), argv[2], different)) { continue; }
+
+    Asset asset = {};
+    asset.path  = entry.path();
+    asset.name  = entry.path().lexically_relative(root).generic_string();
+    asset.hash  = archive::hash_name(asset.name.c_str());
+    asset.size  = entry.file_size(error);
+    if(error) { break; }
+
+    assets.push_back(asset);
+  }
+  if(error) {
+    fprintf(stderr, "Failed to list '%s': %s.\n", argv[1], error.message().c_str());
+    return 1;
+  }
+
+  // Sorted by name so the same directory always packs to the same bytes.
+  std::sort(assets.begin(), assets.end(), [](const Asset& a, const Asset& b) { return a.name < b.name; });
+
+  uint32_t entry_count = (uint32_t)assets.size();
+  uint32_t slot_count  = archive::get_slot_count(entry_count);
+  std::vector<archive::Entry> slots(slot_count);
+
+  uint64_t offset = align_offset(sizeof(archive::Header) + slot_count * sizeof(archive::Entry));
+  for(Asset& asset : assets) {
+    asset.offset = offset;
+    offset       = align_offset(offset + asset.size);
+
+    uint64_t slot = asset.hash & (slot_count - 1);
+    while(slots[slot].hash && slots[slot].hash != asset.hash) { slot = (slot + 1) & (slot_count - 1); }
+
+    if(slots[slot].hash) {
+      fprintf(stderr, "The names of '%s' and another asset hash to the same value, rename one of them.\n",
+              asset.name.c_str());
+      return 1;
+    }
+    slots[slot] = {asset.hash, asset.offset, asset.size};
+  }
+
+  FILE* output = fopen(argv[2], "wb");
+  if(!output) {
+    fprintf(stderr, "Failed to create '%s'.\n", argv[2]);
+    return 1;
+  }
+
+  archive::Header header = {};
+  memcpy(header.magic, archive::magic, sizeof(header.magic));
+  header.entry_count = entry_count;
+  header.slot_count  = slot_count;
+
+  uint64_t written = sizeof(header) + slots.size() * sizeof(archive::Entry);
+  bool failed      = !write_bytes(&header, sizeof(header), output) ||
+                     !write_bytes(slots.data(), slots.size() * sizeof(archive::Entry), output);
+  if(failed) { fprintf(stderr, "Failed to write '%s'.\n", argv[2]); }
+
+  for(size_t i = 0; i < assets.size() && !failed; i++) {
+    const Asset& asset = assets[i];
+
+    // Zeros up to the aligned offset of the asset.
+    static const char padding[archive::blob_alignment] = {};
+    if(!write_bytes(padding, asset.offset - written, output)) {
+      fprintf(stderr, "Failed to write '%s'.\n", argv[2]);
+      failed = true;
+      break;
+    }
+
+    if(!copy_asset(asset, output)) {
+      fprintf(stderr, "Failed to copy '%s'.\n", asset.path.string().c_str());
+      failed = true;
+      break;
+    }
+    written = asset.offset + asset.size;
+  }
+
+  // Buffered writes may only fail here.
+  if(fclose(output) != 0 && !failed) {
+    fprintf(stderr, "Failed to write '%s'.\n", argv[2]);
+    failed = true;
+  }
+  if(failed) {
+    remove(argv[2]);
+    return 1;
+  }
+
+  printf("Packed %u assets, %llu bytes, into '%s'.\n", entry_count, (unsigned long long)written, argv[2]);
+  return 0;
+}